@@ -30,24 +30,12 @@
 #include <asynFloat64.h>
 
 #include "epidRecord.h"
+#include "epidAlgorithm.h"
 #include <epicsExport.h>
 
 typedef struct {
     double setPoint;
-    double actual;
-    double error;
-    double prevError;
-    int feedbackOn;
-    int prevFeedbackOn;
-    double highLimit;
-    double lowLimit;
-    double output;
-    double KP; 
-    double KI; 
-    double KD;
-    double P;
-    double I;
-    double D;
+    epidAlgState alg;
     double callbackInterval;
     double timePerPointRequested;
     double timePerPointActual;
@@ -118,9 +106,10 @@ static long init_record(epidRecord *pepid)
 
     pPvt = callocMustSucceed(1, sizeof(*pPvt), "devEpidFast::init_record");
     pepid->dpvt = pPvt;
-    pPvt->KP = 1;
-    pPvt->lowLimit = 1.;
-    pPvt->highLimit =-1.;
+    epidAlgInit(&pPvt->alg);
+    pPvt->alg.kp = 1;
+    pPvt->alg.drvl = 1.;
+    pPvt->alg.drvh =-1.;
 
     pinstio = (struct instio*)&(pepid->inp.value);
     /* Parse to get inputName, inputChannel, dataString, intervalString,
@@ -321,21 +310,21 @@ static long update_params(epidRecord *pepid)
         computeNumAverage(pPvt);
     }
     /* Copy values from private structure to record */
-    pepid->cval = pPvt->actual;
-    pepid->err  = pPvt->error;
-    pepid->oval = pPvt->output;
-    pepid->p    = pPvt->P;
-    pepid->i    = pPvt->I;
-    pepid->d    = pPvt->D;
+    pepid->cval = pPvt->alg.cval;
+    pepid->err  = pPvt->alg.err;
+    pepid->oval = pPvt->alg.oval;
+    pepid->p    = pPvt->alg.p;
+    pepid->i    = pPvt->alg.i;
+    pepid->d    = pPvt->alg.d;
     pepid->dt   = pPvt->timePerPointActual;
 
     /* Copy values from record to private structure */
-    pPvt->feedbackOn = pepid->fbon;
-    pPvt->highLimit = pepid->drvh;
-    pPvt->lowLimit = pepid->drvl;
-    pPvt->KP = pepid->kp;
-    pPvt->KI = pepid->ki;
-    pPvt->KD = pepid->kd;
+    pPvt->alg.fbon = pepid->fbon;
+    pPvt->alg.drvh = pepid->drvh;
+    pPvt->alg.drvl = pepid->drvl;
+    pPvt->alg.kp = pepid->kp;
+    pPvt->alg.ki = pepid->ki;
+    pPvt->alg.kd = pepid->kd;
     pPvt->setPoint = pepid->val;
     epicsMutexUnlock(pPvt->mutexId);
 
@@ -345,7 +334,7 @@ static long update_params(epidRecord *pepid)
               "    cval=%f, err=%f, oval=%f,\n" 
               "    P=%f, I=%f, D=%f, dt=%f\n", 
               pepid->name, 
-              pPvt->feedbackOn, pPvt->prevFeedbackOn,
+              pPvt->alg.fbon, pPvt->alg.fbop,
               pepid->cval, pepid->err, pepid->oval,
               pepid->p, pepid->i, pepid->d, pepid->dt);
 
@@ -420,63 +409,37 @@ static void do_PID(epidFastPvt *pPvt, double readBack)
                    Converted Ip330PIDServer to base class fastPIDServer,
                    moved to this file.
     07/09/04 MLR   Converted from MPF to asyn, and from C++ to C
+    10/19/26  AG   Moved the PID algorithm to epidAlgorithm.c, which is
+                   shared with the soft device supports.
 */
 {
     double dt;
-    double derror;
-    double dI;
+    double output;
+    double *pout = NULL;
     asynStatus status;
 
     dt = pPvt->callbackInterval;
-    pPvt->actual = readBack;
-    pPvt->prevError = pPvt->error;
-    pPvt->error = pPvt->setPoint - pPvt->actual;
-    derror = pPvt->error - pPvt->prevError;
-    pPvt->P = pPvt->KP*pPvt->error;
-    /* Sanity checks on integral term:
-        * 1) Don't increase I if output >= highLimit
-        * 2) Don't decrease I if output <= lowLimit
-        * 3) Don't change I if feedback is off
-        * 4) Limit the integral term to be in the range betweem DRLV and DRVH
-        * 5) If KI is zero then set the I term to 0.
-    */
-    dI = pPvt->KP*pPvt->KI*pPvt->error*dt;
-    if (pPvt->feedbackOn) {
-        if (!pPvt->prevFeedbackOn) {
-            pPvt->pfloat64Output->read(pPvt->float64OutputPvt, 
-                                       pPvt->pfloat64OutputAsynUser,
-                                       &pPvt->I);
-        } else {
-            if (((pPvt->output > pPvt->lowLimit) &&
-                 (pPvt->output < pPvt->highLimit)) ||
-                ((pPvt->output >= pPvt->highLimit) && ( dI < 0.)) ||
-                ((pPvt->output <= pPvt->lowLimit)  && ( dI > 0.))) {
-                pPvt->I = pPvt->I + dI;
-                if (pPvt->I < pPvt->lowLimit) pPvt->I = pPvt->lowLimit;
-                if (pPvt->I > pPvt->highLimit) pPvt->I = pPvt->highLimit;
-            }
-        }
+    /* When feedback goes from OFF to ON read the current output, so the
+     * integral term starts from it for a bumpless turn-on */
+    if (epidAlgTurningOn(&pPvt->alg)) {
+        status = pPvt->pfloat64Output->read(pPvt->float64OutputPvt, 
+                                            pPvt->pfloat64OutputAsynUser,
+                                            &output);
+        if (status == asynSuccess) pout = &output;
     }
-    if (pPvt->KI == 0.) pPvt->I = 0.;
-    if (dt>0.0) pPvt->D = pPvt->KP*pPvt->KD*(derror/dt); else pPvt->D = 0.0;
-    pPvt->output = (pPvt->P + pPvt->I + pPvt->D);
-    /* Limit output to range from low to high limit */
-    if (pPvt->output > pPvt->highLimit) pPvt->output = pPvt->highLimit;
-    if (pPvt->output < pPvt->lowLimit) pPvt->output = pPvt->lowLimit;
-    
+    epidAlgStep(&pPvt->alg, pPvt->setPoint, readBack, dt, pout);
+
     /* To be consistent with slow feedback we should be implementing a deadband with ODEL here */
 
     /* If feedback is on write output */
-    if (pPvt->feedbackOn) {
+    if (pPvt->alg.fbon) {
         status = pPvt->pfloat64Output->write(pPvt->float64OutputPvt, 
                     pPvt->pfloat64OutputAsynUser,
-                    pPvt->output);
+                    pPvt->alg.oval);
         if (status != asynSuccess) {
             asynPrint(pPvt->pfloat64OutputAsynUser, ASYN_TRACE_ERROR,
                 "devEpidFast, error writing output %s\n",
                 pPvt->pfloat64OutputAsynUser->errorMessage);
         }
     }
-    /* Save state of feedback */
-    pPvt->prevFeedbackOn = pPvt->feedbackOn;
 }
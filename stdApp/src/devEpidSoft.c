@@ -26,6 +26,20 @@
                    if KP is positive and a minimum if KP is negative.
     06/11/03  MLR  Converted to R3.14.2, OSI.
     06/11/03  MLR  Converted to R3.14.2, OSI.
+    10/19/26  AG   Moved the PID and MaxMin algorithms to epidAlgorithm.c,
+                   which is shared with devEpidFast.c.
+    10/19/26  AG   Compute DT from the monotonic clock rather than the
+                   wall clock, which can step.  CT is still set for display.
+    10/19/26  AG   Added asynchronous OUTL writes (OMOD=Async) with
+                   dbCaPutLinkCallback.  APHS shows that the write is
+                   pending, OLAT is the output write latency.
+    10/19/26  AG   CVAL can be computed from several inputs with the CCLC
+                   expression, see devEpidSoftReadInput().
+    10/19/26  AG   The output write is shared with devEpidSoftCallback.c,
+                   see devEpidSoftCommon.c.
+    10/19/26  AG   So is the CCLC input.
+    10/19/26  AG   do_pid returns 1 when the controlled value can't be read,
+                   so that the record doesn't add a history sample.
  */
 
 
@@ -55,8 +69,12 @@
 #include    <epicsTime.h>
 #include    <recGbl.h>
 #include    "epidRecord.h"
+#include    "epidAlgorithm.h"
 #include    <epicsExport.h>
 
+#include "stdCompat.h"
+#include "devEpidSoftCommon.h"
+
 /* Create DSET */
 static long init_record();
 static long do_pid();
@@ -81,146 +99,90 @@ epicsExportAddress(dset, devEpidSoft);
 
 static long init_record(epidRecord *pepid)
 {
-    /* For now we do nothing in this function */
+    devEpidSoftInitRecord(pepid, "devEpidSoft::init_record");
     return(0);
 }
 
 static long do_pid(epidRecord *pepid)
 {
-    epicsTimeStamp  ctp;    /*previous time */
     epicsTimeStamp  ct;     /*current time       */
     double          cval;   /*actual value      */
     double          pcval;  /*previous value of cval */
     double          setp;   /*setpoint          */
+    double          ctm;    /*current monotonic time (seconds) */
     double          dt;     /*delta time (seconds)  */
-    double       kp,ki,kd;  /*gains        */
-    double          di;     /*change in integral term */
-    double          e=0.;   /*error         */
-    double          ep;     /*previous error    */
-    double          de;     /*change in error   */
-    double          oval;   /*new value of manip variable */
-    double          p;      /*proportional contribution*/
-    double          i;      /*integral contribution*/
-    double          d;      /*derivative contribution*/
-    double          sign;
+    double          out;    /*current value of the output link */
+    double          *pout;
+    epidAlgState    alg;    /*algorithm state   */
+
+    /* The asynchronous OUTL write has completed */
+    if (devEpidSoftOutputDone(pepid)) return(0);
 
     pcval = pepid->cval;
     
     /* fetch the controlled value */
-    if (pepid->inp.type == CONSTANT) { /* nothing to control*/
-        if (recGblSetSevr(pepid,SOFT_ALARM,INVALID_ALARM)) return(0);
-    }
-    if (dbGetLink(&pepid->inp,DBR_DOUBLE,&pepid->cval,0,0)) {
-        recGblSetSevr(pepid,LINK_ALARM,INVALID_ALARM);
-        return(0);
+    if ((pepid->inp.type == CONSTANT) && (pepid->cclc[0] == '\0')) { /* nothing to control*/
+        if (recGblSetSevr(pepid,SOFT_ALARM,INVALID_ALARM)) return(1);
     }
+    /* A return of 1, as for DT less than MDT, tells the record that no
+     * feedback step was taken, so it adds no history sample */
+    if (devEpidSoftReadInput(pepid)) return(1);
     
     setp = pepid->val;
     cval = pepid->cval;  /* New value of cval */
-    
-    /* compute time difference and make sure it is large enough*/
-    ctp = pepid->ct;
-    epicsTimeGetCurrent(&ct);
-    dt = epicsTimeDiffInSeconds(&ct, &ctp);
+
+    /* compute time difference and make sure it is large enough.
+     * dt comes from the monotonic clock, which does not step when the
+     * wall clock is corrected.  CT is still the wall clock, for display. */
+    ctm = stdMonotonicSeconds();
+    dt = ctm - pepid->ctm;
     if (dt<pepid->mdt) return(1);
-    
+    epicsTimeGetCurrent(&ct);
+
     /* get the rest of values needed */
-    kp = pepid->kp;
-    ki = pepid->ki;
-    kd = pepid->kd;
-    ep = pepid->err;
-    oval = pepid->oval;
-    p = pepid->p;
-    i = pepid->i;
-    d = pepid->d;
-
-    switch (pepid->fmod) {
-        case epidFeedbackMode_PID:
-            e = setp - cval;
-            de = e - ep;
-            p = kp*e;
-            /* Sanity checks on integral term:
-             * 1) Don't increase I if output >= highLimit
-             * 2) Don't decrease I if output <= lowLimit
-             * 3) Don't change I if feedback is off
-             * 4) Limit the integral term to be in the range betweem DRLV and DRVH
-      			 * 5) If KI is zero then set the I term to 0.
-             */  
-            di = kp*ki*e*dt;
-            if (pepid->fbon) {
-                if (!pepid->fbop) {
-                    /* Feedback just made transition from off to on.  Set the integral
-                       term to the current value of the controlled variable */
-                    if (pepid->outl.type != CONSTANT) {
-                        if (dbGetLink(&pepid->outl,DBR_DOUBLE,&i,0,0)) {
-                            recGblSetSevr(pepid,LINK_ALARM,INVALID_ALARM);
-                        }
-                    }
-                } else {
-                    if (((oval > pepid->drvl) && (oval < pepid->drvh)) ||
-                        ((oval >= pepid->drvh) && ( di < 0.)) ||
-                        ((oval <= pepid->drvl)  && ( di > 0.))) {
-                        i = i + di;
-                        if (i < pepid->drvl) i = pepid->drvl;
-                        if (i > pepid->drvh) i = pepid->drvh;
-                    }
-                }
-            }
-            if (ki == 0) i=0.;
-            if(dt>0.0) d = kp*kd*(de/dt); else d = 0.0;
-            oval = p + i + d;
-            break;
-
-        case epidFeedbackMode_MaxMin:
-            /* For now we don't scale to dt, worry about that later */
-            if (pepid->fbon) {
-                if (!pepid->fbop) {
-                    /* Feedback just made transition from off to on.  Set the output
-                       to the current value of the controlled variable */
-                    if (pepid->outl.type != CONSTANT) {
-                        if (dbGetLink(&pepid->outl,DBR_DOUBLE,&oval,0,0)) {
-                            recGblSetSevr(pepid,LINK_ALARM,INVALID_ALARM);
-                        }
-                    }
-                } else {
-                    e = cval - pcval;
-                    if (d > 0.) sign=1.; else sign=-1.;
-                    if ((kp > 0.) && (e < 0.)) sign = -sign;
-                    if ((kp < 0.) && (e > 0.)) sign = -sign;
-                    d = kp * sign;
-                    oval = pepid->oval + d;
-                }
-            }
-            break;
-          
-        default:
-            epicsPrintf("Invalid feedback mode in EPID\n");
-            break;
+    alg.mode = pepid->fmod;
+    alg.kp   = pepid->kp;
+    alg.ki   = pepid->ki;
+    alg.kd   = pepid->kd;
+    alg.drvl = pepid->drvl;
+    alg.drvh = pepid->drvh;
+    alg.odel = pepid->odel;
+    alg.fbon = pepid->fbon;
+    alg.fbop = pepid->fbop;
+    alg.cval = pcval;
+    alg.err  = pepid->err;
+    alg.p    = pepid->p;
+    alg.i    = pepid->i;
+    alg.d    = pepid->d;
+    alg.oval = pepid->oval;
+
+    /* Feedback is making the transition from off to on.  Read the current
+     * output so the algorithm can do a bumpless turn-on */
+    pout = NULL;
+    if (epidAlgTurningOn(&alg) && (pepid->outl.type != CONSTANT)) {
+        if (dbGetLink(&pepid->outl,DBR_DOUBLE,&out,0,0)) {
+            recGblSetSevr(pepid,LINK_ALARM,INVALID_ALARM);
+        } else {
+            pout = &out;
+        }
     }
-          
-          
-    /* Limit output to range from DRLV to DRVH */
-    if (oval > pepid->drvh) oval = pepid->drvh;
-    if (oval < pepid->drvl) oval = pepid->drvl;
+
+    if (epidAlgStep(&alg, setp, cval, dt, pout)) {
+        epicsPrintf("Invalid feedback mode in EPID\n");
+    }
+
     /* update record*/
-    pepid->ct  = ct;
+    pepid->ct   = ct;
+    pepid->ctm  = ctm;
     pepid->dt   = dt;
-    pepid->err  = e;
-    pepid->cval  = cval;
-    if ((pepid->odel == 0) || (fabs(pepid->oval - oval) > pepid->odel)) {
-        pepid->oval  = oval;
-    }
-    pepid->p  = p;
-    pepid->i  = i;
-    pepid->d  = d;
-    pepid->fbop = pepid->fbon;
-    
-    /* If feedback is on, and output link is a PV_LINK then write the 
-     * output link */
-    if (pepid->fbon && (pepid->outl.type != CONSTANT)) {
-        if (dbPutLink(&pepid->outl,DBR_DOUBLE, &pepid->oval,1)) {
-            recGblSetSevr(pepid,LINK_ALARM,INVALID_ALARM);
-        }
-    } 
+    pepid->err  = alg.err;
+    pepid->cval = alg.cval;
+    pepid->oval = alg.oval;
+    pepid->p    = alg.p;
+    pepid->i    = alg.i;
+    pepid->d    = alg.d;
+    pepid->fbop = alg.fbop;
+
+    devEpidSoftWriteOutput(pepid);
     return(0);
 }
@@ -0,0 +1,109 @@
+/* devEpidSoftCommon.c */
+
+/* devEpidSoftCommon.c - Code shared by the soft epid device supports */
+/*
+ * Modification Log:
+ * -----------------
+ * 10/19/26  AG  First version, from the copies in devEpidSoft.c and
+ *               devEpidSoftCallback.c.
+ * 10/19/26  AG  Added devEpidSoftReadInput().
+ */
+
+#include    <string.h>
+
+#include    <alarm.h>
+#include    <dbDefs.h>
+#include    <dbAccess.h>
+#include    <recGbl.h>
+#include    <dbCa.h>
+#include    <postfix.h>
+#include    <cantProceed.h>
+#include    "epidRecord.h"
+
+#include "stdCompat.h"
+#include "devEpidSoftCommon.h"
+
+typedef struct {
+    double outStart;    /* monotonic time the OUTL write was started */
+} epidSoftPvt;
+
+void devEpidSoftInitRecord(epidRecord *pepid, const char *name)
+{
+    pepid->dpvt = callocMustSucceed(1, sizeof(epidSoftPvt), name);
+}
+
+long devEpidSoftReadInput(epidRecord *pepid)
+{
+    double args[CALCPERFORM_NARGS];
+    struct link *plink;
+    double *pvalue;
+    int i;
+
+    if (pepid->cclc[0] == '\0') {
+        if (dbGetLink(&pepid->inp,DBR_DOUBLE,&pepid->cval,0,0)) {
+            recGblSetSevr(pepid,LINK_ALARM,INVALID_ALARM);
+            return(-1);
+        }
+        return(0);
+    }
+    if (pepid->clcv) {
+        recGblSetSevr(pepid,CALC_ALARM,INVALID_ALARM);
+        return(-1);
+    }
+    for (i=0, plink=&pepid->inpa, pvalue=&pepid->ia; i<EPID_NUM_INPUTS;
+         i++, plink++, pvalue++) {
+        if (plink->type == CONSTANT) continue;
+        if (dbGetLink(plink,DBR_DOUBLE,pvalue,0,0)) {
+            recGblSetSevr(pepid,LINK_ALARM,INVALID_ALARM);
+            return(-1);
+        }
+    }
+    memset(args, 0, sizeof(args));
+    for (i=0, pvalue=&pepid->ia; i<EPID_NUM_INPUTS; i++, pvalue++)
+        args[i] = *pvalue;
+    if (pepid->inp.type != CONSTANT) {
+        if (dbGetLink(&pepid->inp,DBR_DOUBLE,&args[EPID_NUM_INPUTS],0,0)) {
+            recGblSetSevr(pepid,LINK_ALARM,INVALID_ALARM);
+            return(-1);
+        }
+    }
+    if (calcPerform(args, &pepid->cval, pepid->rpcl)) {
+        recGblSetSevr(pepid,CALC_ALARM,INVALID_ALARM);
+        return(-1);
+    }
+    return(0);
+}
+
+void devEpidSoftWriteOutput(epidRecord *pepid)
+{
+    epidSoftPvt *pPvt = (epidSoftPvt *)pepid->dpvt;
+
+    if (!pepid->fbon || (pepid->outl.type == CONSTANT)) return;
+    pPvt->outStart = stdMonotonicSeconds();
+    if ((pepid->omod == epidOutputMode_Async) && (pepid->outl.type == CA_LINK)) {
+        if (dbCaPutLinkCallback(&pepid->outl,DBR_DOUBLE,&pepid->oval,1,
+                (dbCaCallback)dbCaCallbackProcess,&pepid->outl)) {
+            recGblSetSevr(pepid,LINK_ALARM,INVALID_ALARM);
+            return;
+        }
+        /* Stop processing here, and wait for the callback */
+        pepid->aphs = epidAsyncPhase_Output;
+        pepid->pact = TRUE;
+        return;
+    }
+    if (dbPutLink(&pepid->outl,DBR_DOUBLE, &pepid->oval,1)) {
+        recGblSetSevr(pepid,LINK_ALARM,INVALID_ALARM);
+        return;
+    }
+    pepid->olat = stdMonotonicSeconds() - pPvt->outStart;
+}
+
+int devEpidSoftOutputDone(epidRecord *pepid)
+{
+    epidSoftPvt *pPvt = (epidSoftPvt *)pepid->dpvt;
+
+    if (!pepid->pact || (pepid->aphs != epidAsyncPhase_Output)) return(0);
+    pepid->olat = stdMonotonicSeconds() - pPvt->outStart;
+    pepid->aphs = epidAsyncPhase_Idle;
+    return(1);
+}
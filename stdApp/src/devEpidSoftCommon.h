@@ -0,0 +1,50 @@
+/* devEpidSoftCommon.h */
+
+/* devEpidSoftCommon.h - Code shared by the soft epid device supports */
+/*
+ * devEpidSoft.c and devEpidSoftCallback.c differ only in how they trigger
+ * the readback.  Reading the controlled value, which can be computed from
+ * several inputs (CCLC), and the output write, which can be asynchronous
+ * (OMOD=Async), are done here for both.
+ *
+ * Modification Log:
+ * -----------------
+ * 10/19/26  AG  First version, from the copies in devEpidSoft.c and
+ *               devEpidSoftCallback.c.
+ * 10/19/26  AG  Added devEpidSoftReadInput().
+ */
+
+#ifndef INC_devEpidSoftCommon_H
+#define INC_devEpidSoftCommon_H
+
+#include "epidRecord.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Allocate the device private part of the record.  name is the caller, for
+ * the message if the allocation fails. */
+void devEpidSoftInitRecord(epidRecord *pepid, const char *name);
+
+/* Read the controlled value into CVAL.  If CCLC is set, CVAL is the result
+ * of the expression, with A-D read from INPA-INPD and E read from INP, so
+ * several readbacks can be combined without processing another record.
+ * Returns 0, or -1 with the alarm set if a link or the expression failed. */
+long devEpidSoftReadInput(epidRecord *pepid);
+
+/* If feedback is on, write OVAL to OUTL.  In asynchronous mode a CA link is
+ * written with a callback: APHS is set to Output and PACT to TRUE, and the
+ * record is processed again when the write has completed. */
+void devEpidSoftWriteOutput(epidRecord *pepid);
+
+/* Called at the start of do_pid.  Returns 1 if the record is being processed
+ * because the asynchronous OUTL write has completed, in which case OLAT is
+ * set, APHS is back to Idle and do_pid has nothing more to do. */
+int devEpidSoftOutputDone(epidRecord *pepid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_devEpidSoftCommon_H */
@@ -0,0 +1,123 @@
+/* epidAlgorithm.c */
+
+/* epidAlgorithm.c - Feedback algorithms shared by the epid device supports */
+/*
+ * Modification Log:
+ * -----------------
+ * 10/19/26  AG  Factored the PID and MaxMin algorithms out of devEpidSoft.c,
+ *               devEpidSoftCallback.c and devEpidFast.c.  The behavior is
+ *               unchanged, see the modification logs in those files.
+ */
+
+/* A discrete form of the PID algorithm is as follows
+ * M(n) = KP*(E(n) + KI*SUMi(E(i)*dT(i))
+ *         + KD*(E(n) -E(n-1))/dT(n)
+ * where
+ *  M(n)    Value of manipulated variable at nth sampling instant
+ *  KP,KI,KD Proportional, Integral, and Differential Gains
+ *      NOTE: KI is inverse of normal definition of KI
+ *  E(n)    Error at nth sampling instant
+ *  SUMi    Sum from i=0 to i=n
+ *  dT(n)   Time difference between n-1 and n
+ *
+ * The MaxMin algorithm tries to maximize or minimize the controlled value
+ * using, at present, an extremely simple algorithm.  It steps the output by
+ * KP, reversing direction whenever the controlled value moved the wrong way.
+ * It will seek a maximum if KP is positive and a minimum if KP is negative.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "epidAlgorithm.h"
+
+void epidAlgInit(epidAlgState *ps)
+{
+    memset(ps, 0, sizeof(*ps));
+    ps->mode = epidAlgModePID;
+}
+
+int epidAlgStep(epidAlgState *ps, double setp, double cval, double dt,
+                const double *pout)
+{
+    double  kp = ps->kp;
+    double  e = 0.;     /*error         */
+    double  de;         /*change in error   */
+    double  di;         /*change in integral term */
+    double  oval = ps->oval;
+    double  p = ps->p;
+    double  i = ps->i;
+    double  d = ps->d;
+    double  sign;
+    int     status = 0;
+
+    switch (ps->mode) {
+        case epidAlgModePID:
+            e = setp - cval;
+            de = e - ps->err;
+            p = kp*e;
+            /* Sanity checks on integral term:
+             * 1) Don't increase I if output >= highLimit
+             * 2) Don't decrease I if output <= lowLimit
+             * 3) Don't change I if feedback is off
+             * 4) Limit the integral term to be in the range betweem DRLV and DRVH
+             * 5) If KI is zero then set the I term to 0.
+             */
+            di = kp*ps->ki*e*dt;
+            if (ps->fbon) {
+                if (!ps->fbop) {
+                    /* Feedback just made transition from off to on.  Set the integral
+                       term to the current value of the output, for a bumpless turn-on */
+                    if (pout) i = *pout;
+                } else {
+                    if (((oval > ps->drvl) && (oval < ps->drvh)) ||
+                        ((oval >= ps->drvh) && ( di < 0.)) ||
+                        ((oval <= ps->drvl)  && ( di > 0.))) {
+                        i = i + di;
+                        if (i < ps->drvl) i = ps->drvl;
+                        if (i > ps->drvh) i = ps->drvh;
+                    }
+                }
+            }
+            if (ps->ki == 0) i=0.;
+            if (dt>0.0) d = kp*ps->kd*(de/dt); else d = 0.0;
+            oval = p + i + d;
+            break;
+
+        case epidAlgModeMaxMin:
+            /* For now we don't scale to dt, worry about that later */
+            if (ps->fbon) {
+                if (!ps->fbop) {
+                    /* Feedback just made transition from off to on.  Set the output
+                       to the current value of the output device */
+                    if (pout) oval = *pout;
+                } else {
+                    e = cval - ps->cval;
+                    if (d > 0.) sign=1.; else sign=-1.;
+                    if ((kp > 0.) && (e < 0.)) sign = -sign;
+                    if ((kp < 0.) && (e > 0.)) sign = -sign;
+                    d = kp * sign;
+                    oval = ps->oval + d;
+                }
+            }
+            break;
+
+        default:
+            status = -1;
+            break;
+    }
+
+    /* Limit output to range from DRLV to DRVH */
+    if (oval > ps->drvh) oval = ps->drvh;
+    if (oval < ps->drvl) oval = ps->drvl;
+    ps->err  = e;
+    ps->cval = cval;
+    if ((ps->odel == 0) || (fabs(ps->oval - oval) > ps->odel)) {
+        ps->oval = oval;
+    }
+    ps->p = p;
+    ps->i = i;
+    ps->d = d;
+    ps->fbop = ps->fbon;
+    return status;
+}
@@ -0,0 +1,69 @@
+/* epidAlgorithm.h */
+
+/* epidAlgorithm.h - Feedback algorithms shared by the epid device supports */
+/*
+ * This file has no dependencies on EPICS base, so the algorithms can be
+ * compiled and exercised outside of an IOC.
+ *
+ * Modification Log:
+ * -----------------
+ * 10/19/26  AG  Factored the PID and MaxMin algorithms out of devEpidSoft.c,
+ *               devEpidSoftCallback.c and devEpidFast.c.
+ */
+
+#ifndef INC_epidAlgorithm_H
+#define INC_epidAlgorithm_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* These values match the epidFeedbackMode menu in epidRecord.dbd */
+typedef enum {
+    epidAlgModePID    = 0,
+    epidAlgModeMaxMin = 1
+} epidAlgMode;
+
+typedef struct epidAlgState {
+    /* Parameters, set by the caller before each step */
+    int     mode;   /* epidAlgModePID or epidAlgModeMaxMin */
+    double  kp;     /* proportional gain */
+    double  ki;     /* integral gain, repeats per second */
+    double  kd;     /* derivative gain, seconds */
+    double  drvl;   /* low limit on output */
+    double  drvh;   /* high limit on output */
+    double  odel;   /* output deadband, 0 to always update output */
+    int     fbon;   /* feedback on */
+    /* State, carried from one step to the next */
+    int     fbop;   /* feedback state at previous step */
+    double  cval;   /* controlled value */
+    double  err;    /* error */
+    double  p;      /* proportional contribution */
+    double  i;      /* integral contribution */
+    double  d;      /* derivative contribution */
+    double  oval;   /* output */
+} epidAlgState;
+
+/* Initialize the state with the defaults used by the record */
+void epidAlgInit(epidAlgState *ps);
+
+/* True if the next step will turn feedback on.  The caller should then read
+ * the current output so that epidAlgStep() can do a bumpless transfer. */
+#define epidAlgTurningOn(ps) ((ps)->fbon && !(ps)->fbop)
+
+/* Compute one step of the feedback loop.
+ *   setp    setpoint
+ *   cval    new controlled value; ps->cval holds the previous one on entry
+ *   dt      time since the previous step, in seconds
+ *   pout    current value of the output device, used for bumpless transfer
+ *           when feedback turns on.  NULL if it is not available.
+ * Returns 0 on success, -1 if ps->mode is not a known algorithm, in which
+ * case only the output limits and the deadband are applied. */
+int epidAlgStep(epidAlgState *ps, double setp, double cval, double dt,
+                const double *pout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_epidAlgorithm_H */
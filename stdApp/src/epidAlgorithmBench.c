@@ -0,0 +1,72 @@
+/* epidAlgorithmBench.c */
+
+/* epidAlgorithmBench.c - Time the epid feedback algorithms */
+/*
+ * Runs each algorithm around a simulated first order plant and prints the
+ * time per step in ns, so that a change to epidAlgorithm.c can be checked
+ * for a slowdown before it is deployed.
+ *
+ *   epidAlgorithmBench [steps]
+ *
+ * Modification Log:
+ * -----------------
+ * 10/19/26  AG  First version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <epicsTime.h>
+
+#include "epidAlgorithm.h"
+
+#define DEFAULT_STEPS 10000000
+
+/* Stops the compiler from dropping the loop */
+static volatile double sink;
+
+static double runMode(int mode, long steps)
+{
+    epidAlgState s;
+    epicsTimeStamp start, end;
+    double y = 0., setp;
+    long n;
+
+    epidAlgInit(&s);
+    s.mode = mode;
+    s.kp   = (mode == epidAlgModePID) ? 2. : 0.01;
+    s.ki   = 1.;
+    s.kd   = 0.05;
+    s.drvl = -10.;
+    s.drvh = 10.;
+    s.fbon = 1;
+    s.fbop = 1;
+
+    epicsTimeGetCurrent(&start);
+    for (n=0; n<steps; n++) {
+        /* a square wave setpoint keeps the loop moving */
+        setp = (n & 1024) ? 1. : -1.;
+        epidAlgStep(&s, setp, y, 1.e-3, NULL);
+        y += (s.oval - y)*0.01;
+    }
+    epicsTimeGetCurrent(&end);
+    sink = y;
+
+    return(epicsTimeDiffInSeconds(&end, &start) * 1.e9 / steps);
+}
+
+int main(int argc, char *argv[])
+{
+    long steps = DEFAULT_STEPS;
+
+    if (argc > 1) steps = atol(argv[1]);
+    if (steps < 1) {
+        fprintf(stderr, "usage: %s [steps]\n", argv[0]);
+        return(1);
+    }
+
+    printf("epidAlgorithmBench: %ld steps\n", steps);
+    printf("  PID     %8.2f ns/step\n", runMode(epidAlgModePID, steps));
+    printf("  MaxMin  %8.2f ns/step\n", runMode(epidAlgModeMaxMin, steps));
+    return(0);
+}
@@ -0,0 +1,247 @@
+/* epidAlgorithmTest.c */
+
+/* epidAlgorithmTest.c - Unit tests of the epid feedback algorithms */
+/*
+ * The algorithms in epidAlgorithm.c are driven through step responses whose
+ * trajectories are known, either worked out by hand or recorded from the
+ * algorithm as it was factored out of the device supports.  A change that
+ * alters the output of the loop for the same inputs will fail here.
+ *
+ * Modification Log:
+ * -----------------
+ * 10/19/26  AG  First version.
+ */
+
+#include <math.h>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "epidAlgorithm.h"
+
+#define TOLERANCE 1e-9
+
+static int near(double a, double b)
+{
+    return(fabs(a - b) <= TOLERANCE * (1. + fabs(b)));
+}
+
+/* A loop in PID mode with feedback already on, so there is no bumpless
+ * transfer on the first step */
+static void pidSetup(epidAlgState *ps, double kp, double ki, double kd)
+{
+    epidAlgInit(ps);
+    ps->kp   = kp;
+    ps->ki   = ki;
+    ps->kd   = kd;
+    ps->drvl = -10.;
+    ps->drvh = 10.;
+    ps->fbon = 1;
+    ps->fbop = 1;
+}
+
+/* Proportional only: the output is KP times the error, and I stays 0 */
+static void testProportional(void)
+{
+    epidAlgState s;
+    int n, ok = 1;
+
+    testDiag("proportional step response");
+    pidSetup(&s, 2., 0., 0.);
+    for (n=0; n<10; n++) {
+        epidAlgStep(&s, 1., 0., 0.1, NULL);
+        if (!near(s.oval, 2.) || (s.i != 0.)) ok = 0;
+    }
+    testOk(ok, "P: output is KP*E at every step");
+    testOk(near(s.p, 2.) && (s.d == 0.), "P: P=%g D=%g", s.p, s.d);
+}
+
+/* Proportional plus integral, open loop: each step adds KP*KI*E*DT to I */
+static void testIntegral(void)
+{
+    epidAlgState s;
+    int n, ok = 1;
+
+    testDiag("integral ramp with a constant error");
+    pidSetup(&s, 1., 0.5, 0.);
+    for (n=1; n<=20; n++) {
+        epidAlgStep(&s, 1., 0., 0.1, NULL);
+        if (!near(s.i, 0.05*n) || !near(s.oval, 1. + 0.05*n)) ok = 0;
+    }
+    testOk(ok, "PI: I ramps by 0.05 per step, I=%g", s.i);
+}
+
+/* The integral stops growing once the output reaches DRVH, and the output
+ * is limited to DRVH */
+static void testIntegralClamp(void)
+{
+    epidAlgState s;
+    int n;
+    double imax = 0.;
+
+    testDiag("integral clamping at the output limit");
+    pidSetup(&s, 1., 0.5, 0.);
+    s.drvh = 1.2;
+    for (n=0; n<100; n++) {
+        epidAlgStep(&s, 1., 0., 0.1, NULL);
+        if (s.i > imax) imax = s.i;
+    }
+    testOk(near(s.oval, 1.2), "output held at DRVH, OVAL=%g", s.oval);
+    testOk(imax <= 0.2 + TOLERANCE, "I stops at DRVH-P, max I=%g", imax);
+
+    /* with the error reversed the integral unwinds at once */
+    epidAlgStep(&s, -1., 0., 0.1, NULL);
+    testOk(s.i < imax, "I decreases when the error reverses, I=%g", s.i);
+
+    /* KI of 0 clears the integral */
+    s.ki = 0.;
+    epidAlgStep(&s, 1., 0., 0.1, NULL);
+    testOk(s.i == 0., "KI=0 clears I");
+}
+
+/* Derivative: a step of the error by 1 in DT=0.1 gives D=KP*KD*10 */
+static void testDerivative(void)
+{
+    epidAlgState s;
+
+    testDiag("derivative kick on a setpoint step");
+    pidSetup(&s, 1., 0., 0.5);
+    epidAlgStep(&s, 0., 0., 0.1, NULL);
+    testOk(s.d == 0., "no error change, D=%g", s.d);
+    epidAlgStep(&s, 1., 0., 0.1, NULL);
+    testOk(near(s.d, 5.), "error step of 1, D=%g", s.d);
+    testOk(near(s.oval, 6.), "OVAL=P+D=%g", s.oval);
+    epidAlgStep(&s, 2., 0., 0., NULL);
+    testOk(s.d == 0., "DT of 0 gives no D, D=%g", s.d);
+}
+
+/* Feedback turning on sets I to the current output, so the output does not
+ * jump */
+static void testBumpless(void)
+{
+    epidAlgState s;
+    double out = 3.;
+
+    testDiag("bumpless turn-on");
+    pidSetup(&s, 1., 0.5, 0.);
+    s.fbop = 0;
+    testOk(epidAlgTurningOn(&s), "epidAlgTurningOn() when FBON goes 0 to 1");
+    epidAlgStep(&s, 0.1, 0., 0.1, &out);
+    testOk(near(s.i, 3.) && near(s.oval, 3.1), "I=%g OVAL=%g", s.i, s.oval);
+    testOk(!epidAlgTurningOn(&s), "FBOP follows FBON");
+
+    /* with feedback off the integral is left alone */
+    s.fbon = 0;
+    epidAlgStep(&s, 1., 0., 0.1, NULL);
+    testOk(near(s.i, 3.), "FBON=0 leaves I=%g", s.i);
+}
+
+/* The output deadband: OVAL only changes when it moves by more than ODEL */
+static void testDeadband(void)
+{
+    epidAlgState s;
+
+    testDiag("output deadband");
+    pidSetup(&s, 1., 0., 0.);
+    s.odel = 0.5;
+    epidAlgStep(&s, 1., 0., 0.1, NULL);
+    testOk(near(s.oval, 1.), "first change passes, OVAL=%g", s.oval);
+    epidAlgStep(&s, 1.3, 0., 0.1, NULL);
+    testOk(near(s.oval, 1.), "change of 0.3 held, OVAL=%g", s.oval);
+    epidAlgStep(&s, 2., 0., 0.1, NULL);
+    testOk(near(s.oval, 2.), "change of 1 passes, OVAL=%g", s.oval);
+}
+
+/* PI with a little D around a first order plant, y' = (u - y)/tau.  The
+ * reference trajectory was recorded from the algorithm as it was factored
+ * out of devEpidSoft.c. */
+static const struct {
+    int n;
+    double oval;
+    double y;
+} closedLoopRef[] = {
+    { 4, 1.304141312,       0.6852351872},
+    { 9, 1.10335817194578,  0.879367241118857},
+    {14, 1.03486831298946,  0.950873948595281},
+    {19, 1.01156556072397,  0.97838624456014},
+    {24, 1.00371165499834,  0.989650310035179},
+    {29, 1.00111122521032,  0.994637498060802},
+    {34, 1.00027967296149,  0.997040786735455},
+    {39, 1.00003269637252,  0.998292757435176},
+    {44, 0.999971945228587, 0.998986411292935},
+    {49, 0.999966033551897, 0.999387666909653}
+};
+#define NUM_CLOSED_LOOP_REF (sizeof(closedLoopRef)/sizeof(closedLoopRef[0]))
+
+static void testClosedLoop(void)
+{
+    epidAlgState s;
+    double y = 0., dt = 0.1, tau = 1.;
+    int n, k = 0;
+
+    testDiag("closed loop step response of a first order plant");
+    pidSetup(&s, 2., 1., 0.05);
+    for (n=0; n<50; n++) {
+        epidAlgStep(&s, 1., y, dt, NULL);
+        y += (s.oval - y)*dt/tau;
+        if ((k == NUM_CLOSED_LOOP_REF) || (closedLoopRef[k].n != n)) continue;
+        testOk(near(s.oval, closedLoopRef[k].oval) &&
+               near(y, closedLoopRef[k].y),
+               "step %2d: OVAL=%.12g Y=%.12g", n, s.oval, y);
+        k++;
+    }
+}
+
+/* MaxMin steps the output by KP, turning round whenever the controlled
+ * value gets worse, so it ends up hunting around the peak */
+static void testMaxMin(void)
+{
+    epidAlgState s;
+    double u, y;
+    int n;
+
+    testDiag("MaxMin on y = 4 - (u-2)^2");
+    epidAlgInit(&s);
+    s.mode = epidAlgModeMaxMin;
+    s.kp   = 0.25;
+    s.drvl = -10.;
+    s.drvh = 10.;
+    s.fbon = 1;
+    s.fbop = 1;
+    u = 0.;
+    for (n=0; n<60; n++) {
+        y = 4. - (u - 2.)*(u - 2.);
+        epidAlgStep(&s, 0., y, 0.1, NULL);
+        u = s.oval;
+    }
+    testOk(fabs(u - 2.) <= 2.*s.kp + TOLERANCE, "hunting around 2, U=%g", u);
+    testOk(near(fabs(s.d), 0.25), "each step is KP, D=%g", s.d);
+}
+
+/* An unknown mode reports an error, but still applies the limits */
+static void testBadMode(void)
+{
+    epidAlgState s;
+
+    testDiag("unknown feedback mode");
+    pidSetup(&s, 1., 0., 0.);
+    s.mode = 99;
+    s.oval = 20.;
+    testOk(epidAlgStep(&s, 1., 0., 0.1, NULL) == -1, "returns -1");
+    testOk(near(s.oval, 10.), "output limited to DRVH, OVAL=%g", s.oval);
+}
+
+MAIN(epidAlgorithmTest)
+{
+    testPlan(32);
+    testProportional();
+    testIntegral();
+    testIntegralClamp();
+    testDerivative();
+    testBumpless();
+    testDeadband();
+    testClosedLoop();
+    testMaxMin();
+    testBadMode();
+    return testDone();
+}
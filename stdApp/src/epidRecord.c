@@ -65,6 +65,19 @@
  * .16  06-26-03	rls	Port to 3.14; alarm() conflicts with alarm
 				declaration in unistd.h (epidRecord.h->epicsTime.h->
 				osdTime.h->unistd.h) when compiled with SUNPro.
+ * .17  10-19-26        ag      Added circular history arrays of the last NHST
+                                iterations (HTIM, HCVL, HERR, HOVL, HP, HI, HD).
+                                These are allocated once in init_record.
+ * .18  10-19-26        ag      Accumulate the min, max, mean and standard
+                                deviation of DT for device support that
+                                measures it with the monotonic clock (CTM).
+ * .19  10-19-26        ag      Device support may now wait for more than one
+                                asynchronous phase (TRIG and OUTL).  While
+                                APHS is not Idle the record waits for another
+                                callback from device support.
+ * .20  10-19-26        ag      Added INPA-INPD and the CCLC expression, which
+                                device support can use to compute CVAL from
+                                several inputs.  CCLC is compiled here.
  */
 
 #ifdef vxWorks
@@ -74,6 +87,7 @@
 #endif
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 
 #include    <alarm.h>
 #include    <dbDefs.h>
@@ -84,28 +98,26 @@
 #include    <recSup.h>
 #include    <recGbl.h>
 #include    <devSup.h>
+#include    <special.h>
+#include    <cantProceed.h>
+#include    <postfix.h>
 #define GEN_SIZE_OFFSET
 #include    "epidRecord.h"
 #undef  GEN_SIZE_OFFSET
 #include "menuOmsl.h"
 #include    <epicsExport.h>
 
-#include	<epicsVersion.h>
-#ifndef EPICS_VERSION_INT
-#define VERSION_INT(V,R,M,P) ( ((V)<<24) | ((R)<<16) | ((M)<<8) | (P))
-#define EPICS_VERSION_INT VERSION_INT(EPICS_VERSION, EPICS_REVISION, EPICS_MODIFICATION, EPICS_PATCH_LEVEL)
-#endif
-#define LT_EPICSBASE(V,R,M,P) (EPICS_VERSION_INT < VERSION_INT((V),(R),(M),(P)))
+#include "stdCompat.h"
 
 /* Create RSET - Record Support Entry Table*/
 #define report NULL
 #define initialize NULL
 static long init_record();
 static long process();
-#define special NULL
+static long special();
 #define get_value NULL
-#define cvt_dbaddr NULL
-#define get_array_info NULL
+static long cvt_dbaddr();
+static long get_array_info();
 #define put_array_info NULL
 static long get_units();
 static long get_precision();
@@ -149,19 +161,54 @@ struct epidDSET { /* epid DSET */
 
 static void checkAlarms();
 static void monitor();
+static void saveHistory();
+static void dtStatistics();
+static void dtStatisticsReset();
+static void compileCalc();
+static double *historyArray();
 
 
 static long init_record(epidRecord *pepid, int pass)
 {
     struct epidDSET *pdset;
     int status;
-
-    if (pass==0) return(0);
+    struct link *plink;
+    double *pvalue;
+    int i;
+
+    if (pass==0) {
+        /* Allocate the history arrays.  They are never reallocated, so no
+         * memory is allocated while the record is processing. */
+        long n;
+        double *pbuf;
+
+        if (pepid->nhst < 0) pepid->nhst = 0;
+        n = (pepid->nhst > 0) ? pepid->nhst : 1;
+        pbuf = (double *)callocMustSucceed(7*n, sizeof(double),
+                                           "epid: init_record");
+        pepid->htim = pbuf;
+        pepid->hcvl = pbuf + n;
+        pepid->herr = pbuf + 2*n;
+        pepid->hovl = pbuf + 3*n;
+        pepid->hp   = pbuf + 4*n;
+        pepid->hi   = pbuf + 5*n;
+        pepid->hd   = pbuf + 6*n;
+        pepid->hnum = 0;
+        pepid->hidx = 0;
+        return(0);
+    }
     /* initialize the setpoint for constant setpoint */
     if (pepid->stpl.type == CONSTANT){
        if(recGblInitConstantLink(&pepid->stpl,DBF_DOUBLE,&pepid->val))
                 pepid->udf = FALSE;
     }
+    /* initialize constant inputs for the CCLC expression */
+    for (i=0, plink=&pepid->inpa, pvalue=&pepid->ia; i<EPID_NUM_INPUTS;
+         i++, plink++, pvalue++) {
+        if (plink->type == CONSTANT)
+            recGblInitConstantLink(plink,DBF_DOUBLE,pvalue);
+    }
+    compileCalc(pepid);
 
     /* must have dset defined */
     if (!(pdset = (struct epidDSET *)(pepid->dset))) {
@@ -203,10 +250,25 @@ static long process(epidRecord *pepid)
     }
 
     status = (*pdset->do_pid)(pepid);
-    /* See if device support set pact=true, meaning  it will call us back */
+    /* See if device support set pact=true, meaning  it will call us back.
+     * Device support with more than one asynchronous phase leaves APHS set
+     * to the phase it is waiting for. */
     if (!pact && pepid->pact) return(0);
+    if (pepid->aphs != epidAsyncPhase_Idle) return(0);
     pepid->pact = TRUE;
     recGblGetTimeStamp(pepid);
+    /* Device support returns non-zero when it took no feedback step, e.g.
+     * when DT is less than MDT or the controlled value can't be read */
+    if (status == 0) saveHistory(pepid);
+    /* Only intervals measured by device support with the monotonic clock
+     * are counted.  CTMP is the CTM of the last interval counted, rather
+     * than CTM when this pass started, because with an asynchronous phase
+     * CTM was already advanced by the first pass.  The first CTM after
+     * startup is not an interval. */
+    if ((status == 0) && (pepid->ctm != pepid->ctmp)) {
+        if (pepid->ctmp != 0.) dtStatistics(pepid);
+        pepid->ctmp = pepid->ctm;
+    }
     checkAlarms(pepid);
     monitor(pepid);
     recGblFwdLink(pepid);
@@ -214,6 +276,56 @@ static long process(epidRecord *pepid)
     return(status);
 }
 
+static long special(struct dbAddr *paddr, int after)
+{
+    epidRecord *pepid = (epidRecord *)paddr->precord;
+    int fieldIndex = dbGetFieldIndex(paddr);
+
+    if (!after) return(0);
+    switch (fieldIndex) {
+        case epidRecordCCLC:
+            compileCalc(pepid);
+            db_post_events(pepid,&pepid->clcv,DBE_VALUE);
+            break;
+        case epidRecordDTRS:
+            if (pepid->dtrs) {
+                dtStatisticsReset(pepid);
+                pepid->dtrs = 0;
+                db_post_events(pepid,&pepid->dtrs,DBE_VALUE);
+            }
+            break;
+        default:
+            recGblDbaddrError(S_db_badChoice, paddr, "epid: special");
+            return(S_db_badChoice);
+    }
+    return(0);
+}
+
+static long cvt_dbaddr(struct dbAddr *paddr)
+{
+    epidRecord *pepid = (epidRecord *)paddr->precord;
+    double *parray = historyArray(pepid, dbGetFieldIndex(paddr));
+
+    if (parray == NULL) return(S_db_badField);
+    paddr->pfield = parray;
+    paddr->no_elements = (pepid->nhst > 0) ? pepid->nhst : 1;
+    paddr->field_type = DBF_DOUBLE;
+    paddr->field_size = sizeof(double);
+    paddr->dbr_field_type = DBR_DOUBLE;
+    return(0);
+}
+
+static long get_array_info(struct dbAddr *paddr, long *no_elements, long *offset)
+{
+    epidRecord *pepid = (epidRecord *)paddr->precord;
+
+    /* The arrays are circular buffers; once full the oldest element is the
+     * next one to be written.  dbGet wraps around the end of the array. */
+    *no_elements = pepid->hnum;
+    *offset = (pepid->hnum < pepid->nhst) ? 0 : pepid->hidx;
+    return(0);
+}
+
 static long get_units(struct dbAddr *paddr, char *units)
 {
     struct epidRecord   *pepid=(struct epidRecord *)paddr->precord;
@@ -229,7 +341,8 @@ static long get_precision(struct dbAddr *paddr, long *precision)
 
     *precision = pepid->prec;
     if (fieldIndex == epidRecordVAL
-    ||  fieldIndex == epidRecordCVAL) return(0);
+    ||  fieldIndex == epidRecordCVAL
+    ||  fieldIndex == epidRecordHCVL) return(0);
     recGblGetPrec(paddr,precision);
     return(0);
 }
@@ -246,14 +359,19 @@ static long get_graphic_double(struct dbAddr *paddr, struct dbr_grDouble *pgd)
     || fieldIndex == epidRecordHIGH
     || fieldIndex == epidRecordLOW
     || fieldIndex == epidRecordLOLO
-    || fieldIndex == epidRecordCVAL){
+    || fieldIndex == epidRecordCVAL
+    || fieldIndex == epidRecordHCVL){
         pgd->upper_disp_limit = pepid->hopr;
         pgd->lower_disp_limit = pepid->lopr;
     } else if (
        fieldIndex == epidRecordOVAL
     || fieldIndex == epidRecordP
     || fieldIndex == epidRecordI
-    || fieldIndex == epidRecordD) {
+    || fieldIndex == epidRecordD
+    || fieldIndex == epidRecordHOVL
+    || fieldIndex == epidRecordHP
+    || fieldIndex == epidRecordHI
+    || fieldIndex == epidRecordHD) {
         pgd->upper_disp_limit = pepid->drvh;
         pgd->lower_disp_limit = pepid->drvl;
     } else recGblGetGraphicDouble(paddr,pgd);
@@ -300,6 +418,94 @@ static long get_alarm_double(struct dbAddr *paddr, struct dbr_alDouble *pad)
     return(0);
 }
 
+static double *historyArray(epidRecord *pepid, int fieldIndex)
+{
+    switch (fieldIndex) {
+        case epidRecordHTIM: return(pepid->htim);
+        case epidRecordHCVL: return(pepid->hcvl);
+        case epidRecordHERR: return(pepid->herr);
+        case epidRecordHOVL: return(pepid->hovl);
+        case epidRecordHP:   return(pepid->hp);
+        case epidRecordHI:   return(pepid->hi);
+        case epidRecordHD:   return(pepid->hd);
+    }
+    return(NULL);
+}
+
+static void saveHistory(epidRecord *pepid)
+{
+    long n = pepid->hidx;
+
+    if (pepid->nhst <= 0) return;
+    pepid->htim[n] = pepid->time.secPastEpoch + pepid->time.nsec/1.e9;
+    pepid->hcvl[n] = pepid->cval;
+    pepid->herr[n] = pepid->err;
+    pepid->hovl[n] = pepid->oval;
+    pepid->hp[n]   = pepid->p;
+    pepid->hi[n]   = pepid->i;
+    pepid->hd[n]   = pepid->d;
+    if (++n >= pepid->nhst) n = 0;
+    pepid->hidx = n;
+    if (pepid->hnum < pepid->nhst) pepid->hnum++;
+}
+
+static void compileCalc(epidRecord *pepid)
+{
+    short error_number;
+
+    pepid->clcv = 0;
+    pepid->rpcl[0] = '\0';
+    if (pepid->cclc[0] == '\0') return;
+    pepid->clcv = postfix(pepid->cclc, pepid->rpcl, &error_number);
+    if (pepid->clcv) {
+        recGblRecordError(S_db_badField, (void *)pepid,
+                          "epid: Illegal CCLC expression");
+    }
+}
+
+static void dtStatistics(epidRecord *pepid)
+{
+    unsigned short monitor_mask = DBE_VALUE|DBE_LOG;
+    double dt = pepid->dt;
+    double delta;
+
+    /* Welford's running mean and variance */
+    pepid->dtns++;
+    delta = dt - pepid->dtav;
+    pepid->dtav += delta/pepid->dtns;
+    pepid->dtm2 += delta*(dt - pepid->dtav);
+    if (pepid->dtns == 1) {
+        pepid->dtmn = dt;
+        pepid->dtmx = dt;
+    } else {
+        if (dt < pepid->dtmn) pepid->dtmn = dt;
+        if (dt > pepid->dtmx) pepid->dtmx = dt;
+    }
+    pepid->dtsd = (pepid->dtns > 1) ? sqrt(pepid->dtm2/(pepid->dtns - 1)) : 0.;
+    db_post_events(pepid,&pepid->dtns,monitor_mask);
+    db_post_events(pepid,&pepid->dtmn,monitor_mask);
+    db_post_events(pepid,&pepid->dtmx,monitor_mask);
+    db_post_events(pepid,&pepid->dtav,monitor_mask);
+    db_post_events(pepid,&pepid->dtsd,monitor_mask);
+}
+
+static void dtStatisticsReset(epidRecord *pepid)
+{
+    unsigned short monitor_mask = DBE_VALUE|DBE_LOG;
+
+    pepid->dtns = 0;
+    pepid->dtmn = 0.;
+    pepid->dtmx = 0.;
+    pepid->dtav = 0.;
+    pepid->dtsd = 0.;
+    pepid->dtm2 = 0.;
+    db_post_events(pepid,&pepid->dtns,monitor_mask);
+    db_post_events(pepid,&pepid->dtmn,monitor_mask);
+    db_post_events(pepid,&pepid->dtmx,monitor_mask);
+    db_post_events(pepid,&pepid->dtav,monitor_mask);
+    db_post_events(pepid,&pepid->dtsd,monitor_mask);
+}
+
 static void checkAlarms(epidRecord *pepid)
 {
     double      val;
@@ -398,6 +604,10 @@ static void monitor(epidRecord *pepid)
        db_post_events(pepid,&pepid->dt,monitor_mask);
        pepid->dtp = pepid->dt;
     }
+    if (pepid->oltp != pepid->olat) {
+       db_post_events(pepid,&pepid->olat,monitor_mask);
+       pepid->oltp = pepid->olat;
+    }
     if (pepid->errp != pepid->err) {
        db_post_events(pepid,&pepid->err,monitor_mask);
        pepid->errp = pepid->err;
@@ -406,5 +616,9 @@ static void monitor(epidRecord *pepid)
        db_post_events(pepid,&pepid->cval,monitor_mask);
        pepid->cvlp = pepid->cval;
     }
+    /* The history arrays are read with a single get, only post the count */
+    if (pepid->nhst > 0) {
+       db_post_events(pepid,&pepid->hnum,monitor_mask);
+    }
     return;
 }
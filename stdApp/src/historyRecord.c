@@ -0,0 +1,420 @@
+/* historyRecord.c - Record Support Routines for the history record */
+/*
+ * The history record keeps a history of up to eight input links, sharing
+ * one time axis, and publishes it as arrays.  Each time the record
+ * processes, it reads its input links and adds a sample to a pvHistory
+ * store (see pvHistoryStore.h) named after the record.  So it can be
+ * scanned periodically, or processed by CP input links on monitor events,
+ * and the tiers, files, compression and queries configured for a pvHistory
+ * store all work with a history record.
+ *
+ * INPA to INPH are the channels, the first NCHN of them, or if NCHN isn't
+ * set, up to the last input link that isn't a constant.  The sample time
+ * is the record's time stamp.  With INTV set, a sample is taken only when
+ * the time reaches a new multiple of INTV seconds.  The arrays TIMS, HOUR
+ * and VALA to VALH are published every PPER seconds, or after every sample
+ * if PPER is 0, newest sample first.  The arrays aren't kept as such: each
+ * read copies one of them out of the store into a buffer of NSAM doubles,
+ * so a record costs its store and that one buffer.  A read sees the store
+ * as it is then, with any samples taken since the last publish.
+ *
+ * When the arrays are published, so are the min, max, mean and standard
+ * deviation of each channel, over the whole history (MINx, MAXx, AVGx,
+ * SDVx) and over the last RWIN seconds (RMNx, RMXx, RAVx, RSDx), as scalar
+ * fields for alarms and links.
+ *
+ * Modification Log:
+ * -----------------
+ * 10/19/26  AG  First version, to replace the record chain of pvHistory.db.
+ * 10/19/26  AG  Window statistics.
+ * 10/19/26  AG  The arrays are built from the store when they're read.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <dbDefs.h>
+#include <alarm.h>
+#include <dbAccess.h>
+#include <dbEvent.h>
+#include <dbFldTypes.h>
+#include <errMdef.h>
+#include <recSup.h>
+#include <recGbl.h>
+#include <cantProceed.h>
+#include <epicsAssert.h>
+
+#define GEN_SIZE_OFFSET
+#include "historyRecord.h"
+#undef  GEN_SIZE_OFFSET
+#include "pvHistoryStore.h"
+#include "epicsExport.h"
+
+#include "stdCompat.h"
+
+/* Create RSET - Record Support Entry Table */
+#define report NULL
+#define initialize NULL
+static long init_record(struct dbCommon *pcommon, int pass);
+static long process(struct dbCommon *pcommon);
+#define special NULL
+#define get_value NULL
+static long cvt_dbaddr(DBADDR *paddr);
+static long get_array_info(DBADDR *paddr, long *no_elements, long *offset);
+#define put_array_info NULL
+static long get_units(DBADDR *paddr, char *units);
+static long get_precision(const DBADDR *paddr, long *precision);
+#define get_enum_str NULL
+#define get_enum_strs NULL
+#define put_enum_str NULL
+static long get_graphic_double(DBADDR *paddr, struct dbr_grDouble *pgd);
+#define get_control_double NULL
+#define get_alarm_double NULL
+
+rset historyRSET={
+	RSETNUMBER,
+	report,
+	initialize,
+	init_record,
+	process,
+	special,
+	get_value,
+	cvt_dbaddr,
+	get_array_info,
+	put_array_info,
+	get_units,
+	get_precision,
+	get_enum_str,
+	get_enum_strs,
+	put_enum_str,
+	get_graphic_double,
+	get_control_double,
+	get_alarm_double };
+epicsExportAddress(rset,historyRSET);
+#undef special		/* cvt_dbaddr sets paddr->special */
+
+typedef struct historyPvt {
+	pvHistoryStore *pstore;
+	double	sample_bin;		/* time/INTV of the last sample */
+	double	publish_time;	/* time of the last publish */
+	double	*view;			/* NSAM elements, the array being read */
+	double	*column[HISTORY_MAX_CHAN];	/* for pvHistoryStoreCopy */
+	double	sample[HISTORY_MAX_CHAN];
+	pvHistoryWindow window[HISTORY_MAX_CHAN];
+} historyPvt;
+
+/* the fields of a statistic of a channel, in the order MIN, MAX, AVG, SDV,
+ * then RMN, RMX, RAV, RSD for the recent window.  historyRecord.dbd
+ * declares them one after the other, MINA to RSDH.
+ */
+#define HISTORY_NUM_STATS 8
+#define statField(prec, stat, chan) \
+	((&(prec)->mina)[(stat)*HISTORY_MAX_CHAN + (chan)])
+STATIC_ASSERT(offsetof(historyRecord, rsdh) - offsetof(historyRecord, mina) ==
+	(HISTORY_NUM_STATS*HISTORY_MAX_CHAN - 1)*sizeof(double));
+STATIC_ASSERT(historyRecordRSDH - historyRecordMINA ==
+	HISTORY_NUM_STATS*HISTORY_MAX_CHAN - 1);
+
+/* &prec->vala + j is the key of channel j's array, see monitor() */
+STATIC_ASSERT(offsetof(historyRecord, valh) - offsetof(historyRecord, vala) ==
+	HISTORY_MAX_CHAN - 1);
+
+static void publish(historyRecord *prec, historyPvt *ppvt);
+static long publishStats(historyRecord *prec, historyPvt *ppvt);
+static int takeSample(historyRecord *prec, historyPvt *ppvt, double t);
+static void monitor(historyRecord *prec, int published);
+
+
+static long init_record(struct dbCommon *pcommon, int pass)
+{
+	historyRecord *prec = (historyRecord *)pcommon;
+	historyPvt *ppvt;
+	struct link *plink;
+	int		j;
+
+	if (pass == 0) {
+		/* Unless NCHN is set, the channels go up to the last input that
+		 * isn't a constant.
+		 */
+		if (prec->nchn <= 0 || prec->nchn > HISTORY_MAX_CHAN) {
+			prec->nchn = 0;
+			for (j=0; j<HISTORY_MAX_CHAN; j++) {
+				if ((&prec->inpa)[j].type != CONSTANT) prec->nchn = j+1;
+			}
+		}
+		if (prec->nsam < 1) prec->nsam = 1;
+
+		ppvt = (historyPvt *)callocMustSucceed(1, sizeof(historyPvt),
+			"history: init_record");
+		ppvt->view = (double *)callocMustSucceed(prec->nsam, sizeof(double),
+			"history: init_record");
+		ppvt->sample_bin = -1.0;
+		prec->rpvt = ppvt;
+		return(0);
+	}
+
+	ppvt = (historyPvt *)prec->rpvt;
+	if (prec->nchn == 0) {
+		recGblRecordError(S_db_badField, (void *)prec,
+			"history: init_record, no input links");
+		return(S_db_badField);
+	}
+	for (j=0; j<prec->nchn; j++) {
+		plink = &prec->inpa + j;
+		if (plink->type == CONSTANT)
+			recGblInitConstantLink(plink, DBF_DOUBLE, &ppvt->sample[j]);
+	}
+
+	/* A store kept in a file may already hold a history */
+	ppvt->pstore = pvHistoryStoreCreate(prec->name, prec->nchn, prec->nsam);
+	publish(prec, ppvt);
+	if (prec->nord > 0) prec->udf = FALSE;
+	return(0);
+}
+
+static long process(struct dbCommon *pcommon)
+{
+	historyRecord *prec = (historyRecord *)pcommon;
+	historyPvt *ppvt = (historyPvt *)prec->rpvt;
+	double	t;
+	int		published = 0;
+
+	prec->pact = TRUE;
+	/* a record without channels is never processed again */
+	if (ppvt->pstore == NULL) return(S_db_badField);
+
+	recGblGetTimeStamp(prec);
+	t = prec->time.secPastEpoch + prec->time.nsec/1.e9;
+
+	if (prec->clr) {
+		pvHistoryStoreClear(ppvt->pstore, t);
+		prec->clr = 0;
+		db_post_events(prec, &prec->clr, DBE_VALUE);
+		published = 1;
+	} else if (takeSample(prec, ppvt, t)) {
+		prec->udf = FALSE;
+		/* hold the arrays until the publish period has passed */
+		if (prec->pper <= 0.0 || t - ppvt->publish_time >= prec->pper)
+			published = 1;
+	}
+	if (published) {
+		publish(prec, ppvt);
+		ppvt->publish_time = t;
+	}
+
+	monitor(prec, published);
+	recGblFwdLink(prec);
+	prec->pact = FALSE;
+	return(0);
+}
+
+/* Read the input links and add a sample.  Returns 1 if a sample was added. */
+static int takeSample(historyRecord *prec, historyPvt *ppvt, double t)
+{
+	struct link *plink;
+	double	bin = 0.0;
+	int		j;
+
+	if (prec->intv > 0.0) {
+		bin = floor(t/prec->intv);
+		if (bin == ppvt->sample_bin) return(0);
+	}
+
+	for (j=0; j<prec->nchn; j++) {
+		plink = &prec->inpa + j;
+		if (plink->type == CONSTANT) continue;
+		if (dbGetLink(plink, DBR_DOUBLE, &ppvt->sample[j], 0, 0)) {
+			recGblSetSevr(prec, LINK_ALARM, INVALID_ALARM);
+			return(0);
+		}
+	}
+
+	pvHistoryStoreAdd(ppvt->pstore, t, ppvt->sample);
+	ppvt->sample_bin = bin;
+	return(1);
+}
+
+/* Update VAL, NORD and the statistics.  The arrays are only copied out of
+ * the store when they're read.
+ */
+static void publish(historyRecord *prec, historyPvt *ppvt)
+{
+	long	n;
+
+	pvHistoryStoreCopy(ppvt->pstore, &prec->val, ppvt->column, 1);
+	n = publishStats(prec, ppvt);
+	prec->nord = (n < prec->nsam) ? n : prec->nsam;
+}
+
+/* set a statistic, posting it if it changed */
+static void statSet(historyRecord *prec, double *pfield, double value)
+{
+	if (*pfield == value) return;
+	*pfield = value;
+	db_post_events(prec, pfield, DBE_VALUE|DBE_LOG);
+}
+
+/* The statistics of the whole history, then of the recent window.
+ * Returns the number of samples in the history.
+ */
+static long publishStats(historyRecord *prec, historyPvt *ppvt)
+{
+	pvHistoryWindow *pw;
+	epicsUInt32 rcnt = 0;
+	long	n = 0;
+	int		j, w;
+
+	for (w=0; w<2; w++) {
+		if (w == 0)
+			n = pvHistoryStoreWindow(ppvt->pstore, 0.0, ppvt->window);
+		else if (prec->rwin > 0.0)
+			rcnt = pvHistoryStoreWindow(ppvt->pstore, prec->rwin, ppvt->window);
+		else
+			break;
+		for (j=0; j<prec->nchn; j++) {
+			pw = &ppvt->window[j];
+			statSet(prec, &statField(prec, 4*w, j), pw->min);
+			statSet(prec, &statField(prec, 4*w + 1, j), pw->max);
+			statSet(prec, &statField(prec, 4*w + 2, j), pw->mean);
+			statSet(prec, &statField(prec, 4*w + 3, j), pw->sdev);
+		}
+	}
+	if (prec->rcnt != rcnt) {
+		prec->rcnt = rcnt;
+		db_post_events(prec, &prec->rcnt, DBE_VALUE|DBE_LOG);
+	}
+	return(n);
+}
+
+static void monitor(historyRecord *prec, int published)
+{
+	unsigned short monitor_mask;
+	int		j;
+
+	if (prec->udf == TRUE) {
+#if LT_EPICSBASE(3,15,0,2)
+		recGblSetSevr(prec, UDF_ALARM, INVALID_ALARM);
+#else
+		recGblSetSevr(prec, UDF_ALARM, prec->udfs);
+#endif
+	}
+
+	monitor_mask = recGblResetAlarms(prec);
+	if (published) monitor_mask |= DBE_VALUE|DBE_LOG;
+	if (monitor_mask) db_post_events(prec, &prec->val, monitor_mask);
+	if (!published) return;
+
+	db_post_events(prec, &prec->nord, DBE_VALUE|DBE_LOG);
+	/* the array members hold nothing, their addresses are the keys */
+	db_post_events(prec, &prec->tims, DBE_VALUE|DBE_LOG);
+	db_post_events(prec, &prec->hour, DBE_VALUE|DBE_LOG);
+	for (j=0; j<prec->nchn; j++)
+		db_post_events(prec, &prec->vala + j, DBE_VALUE|DBE_LOG);
+}
+
+/* Copy the array of a field out of the store into the view, newest sample
+ * first.  Returns the number of samples, or -1 if the field isn't one of
+ * the arrays in use.
+ */
+static long fillView(historyRecord *prec, historyPvt *ppvt, int fieldIndex)
+{
+	const double scale = 1.0/3600;
+	double	*view = ppvt->view;
+	double	t0;
+	long	i, n;
+	int		j = fieldIndex - historyRecordVALA;
+
+	if (ppvt->pstore == NULL) return(-1);
+	if (j >= 0 && j < HISTORY_MAX_CHAN) {
+		if (j >= prec->nchn) return(-1);
+		ppvt->column[j] = view;
+		n = pvHistoryStoreCopy(ppvt->pstore, NULL, ppvt->column, prec->nsam);
+		ppvt->column[j] = NULL;
+		return(n);
+	}
+	if (fieldIndex != historyRecordTIMS && fieldIndex != historyRecordHOUR)
+		return(-1);
+	n = pvHistoryStoreCopy(ppvt->pstore, view, ppvt->column, prec->nsam);
+	if (fieldIndex == historyRecordHOUR) {
+		t0 = view[0];
+		for (i=0; i<n; i++) view[i] = (view[i] - t0)*scale;
+	}
+	return(n);
+}
+
+/* pfield is left at the field itself, which is what db_post_events() is
+ * given.  get_array_info() points it at the view, and dbGet() puts it back
+ * after the read.
+ */
+static long cvt_dbaddr(DBADDR *paddr)
+{
+	historyRecord *prec = (historyRecord *)paddr->precord;
+	int		fieldIndex = dbGetFieldIndex(paddr);
+	int		j = fieldIndex - historyRecordVALA;
+
+	if (fieldIndex != historyRecordTIMS && fieldIndex != historyRecordHOUR &&
+		(j < 0 || j >= HISTORY_MAX_CHAN))
+		return(S_db_badField);
+	paddr->no_elements = (j >= prec->nchn) ? 1 : prec->nsam;
+	paddr->field_type = DBF_DOUBLE;
+	paddr->field_size = sizeof(double);
+	paddr->dbr_field_type = DBR_DOUBLE;
+	paddr->special = SPC_NOMOD;
+	return(0);
+}
+
+/* Called with the record locked, which keeps the view to one reader */
+static long get_array_info(DBADDR *paddr, long *no_elements, long *offset)
+{
+	historyRecord *prec = (historyRecord *)paddr->precord;
+	historyPvt *ppvt = (historyPvt *)prec->rpvt;
+	long	n = fillView(prec, ppvt, dbGetFieldIndex(paddr));
+
+	*no_elements = (n > 0) ? n : 0;
+	*offset = 0;
+	paddr->pfield = ppvt->view;
+	return(0);
+}
+
+static long get_units(DBADDR *paddr, char *units)
+{
+	historyRecord *prec = (historyRecord *)paddr->precord;
+	int		fieldIndex = dbGetFieldIndex(paddr);
+
+	if (fieldIndex == historyRecordVAL || fieldIndex == historyRecordTIMS)
+		strncpy(units, "s", DB_UNITS_SIZE);
+	else if (fieldIndex == historyRecordHOUR)
+		strncpy(units, "h", DB_UNITS_SIZE);
+	else
+		strncpy(units, prec->egu, DB_UNITS_SIZE);
+	return(0);
+}
+
+static long get_precision(const DBADDR *paddr, long *precision)
+{
+	historyRecord *prec = (historyRecord *)paddr->precord;
+	int		fieldIndex = dbGetFieldIndex(paddr);
+
+	*precision = prec->prec;
+	if ((fieldIndex >= historyRecordVALA && fieldIndex <= historyRecordVALH) ||
+		(fieldIndex >= historyRecordMINA && fieldIndex <= historyRecordRSDH))
+		return(0);
+	recGblGetPrec(paddr, precision);
+	return(0);
+}
+
+static long get_graphic_double(DBADDR *paddr, struct dbr_grDouble *pgd)
+{
+	historyRecord *prec = (historyRecord *)paddr->precord;
+	int		fieldIndex = dbGetFieldIndex(paddr);
+
+	if ((fieldIndex >= historyRecordVALA && fieldIndex <= historyRecordVALH) ||
+		(fieldIndex >= historyRecordMINA && fieldIndex <= historyRecordRSDH)) {
+		pgd->upper_disp_limit = prec->hopr;
+		pgd->lower_disp_limit = prec->lopr;
+	} else recGblGetGraphicDouble(paddr, pgd);
+	return(0);
+}
@@ -1,90 +1,292 @@
+/* pvHistory.c - aSub routines that keep a short history of a few PVs
+ *
+ * Inputs:  A  clear flag, B  current secsPastEpoch, C  publish period (s),
+ *          D, E, F, ...  current PV values
+ * Outputs: VALA  time of the newest sample, VALB  sample times,
+ *          VALC  sample times in hours relative to the newest sample,
+ *          VALD, VALE, VALF, ...  sample values
+ * The newest sample is element 0 of each output array.  Every input from D
+ * on, up to U, whose FTx and FTVx are DOUBLE and whose NOVx is at least
+ * NOVB is a channel of the history.
+ *
+ * pvHistoryTier publishes one tier of consolidated bins of a history (see
+ * pvHistoryStore.h), for one channel.
+ * Inputs:  A  name of the pvHistory record (CHAR array, or STRING for names
+ *          of up to 39 characters), B  tier, C  channel (LONG, counting
+ *          from 0)
+ * Outputs: VALA  bin start times, VALB  min, VALC  max, VALD  mean,
+ *          VALE  number of samples in the bin
+ *
+ * pvHistoryQuery publishes the samples of a history from time B to C,
+ * decimated to D samples keeping the min and max.
+ * Inputs:  A  name of the pvHistory record (CHAR array, or STRING for names
+ *          of up to 39 characters), B, C  start and end time (secsPastEpoch,
+ *          or 0 or less for relative to the newest sample), D  most samples
+ *          to publish (LONG, 0 for NOVA)
+ * Outputs: VALA  sample times, VALB, VALC, ...  sample values of each
+ *          channel, NEVA, NEVB, ...  the number of samples
+ *
+ * Modification Log:
+ * -----------------
+ * 10/19/26  AG  Samples go into a ring buffer, so taking a sample no longer
+ *               shifts the output arrays.  The ring is copied out to the
+ *               output arrays only when they are published, every sample or
+ *               once every C seconds.
+ * 10/19/26  AG  VALC is computed with a single subtract and scale per element,
+ *               and only if NOVC holds the whole history.  VALA publishes the
+ *               time VALC is relative to, so that clients can do without VALC.
+ * 10/19/26  AG  Any number of channels, D to U.  The ring moved to
+ *               pvHistoryStore.c, which keeps all channels in one block.
+ * 10/19/26  AG  Added pvHistoryTier.
+ * 10/19/26  AG  A history kept in a file isn't replaced by the restored
+ *               arrays.
+ * 10/19/26  AG  Added pvHistoryQuery.
+ * 10/19/26  AG  pvHistoryQuery takes the name as a CHAR array, since a STRING
+ *               holds only 39 characters, and logs a name it can't find.
+ * 10/19/26  AG  So does pvHistoryTier.
+ * 10/19/26  AG  Held outputs no longer return 1, which the record shows in
+ *               VAL.  With EFLG=NEVER the routine posts the arrays itself
+ *               when it publishes them.
+ */
+
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <stdio.h>
 
 #include <dbDefs.h>
 #include <dbCommon.h>
 #include <recSup.h>
+#include <dbEvent.h>
+#include <recGbl.h>
+#include <alarm.h>
+#include <cantProceed.h>
+#include <menuFtype.h>
 #include <aSubRecord.h>
 
+#include "pvHistoryStore.h"
+
+#include "stdCompat.h"
+
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #define MIN(a,b) ((a) > (b) ? (b) : (a))
 #define NINT(f)  (int)((f)>0 ? (f)+0.5 : (f)-0.5)
 
 volatile int pvHistoryDebug=0;
 
+#define PVHISTORY_MAX_CHAN 18	/* inputs D to U */
+
+typedef struct pvHistoryPvt {
+	pvHistoryStore *pstore;
+	double	publish_time;	/* time of the last publish */
+	int		loaded;			/* output arrays have been taken into the store */
+	double	*out[PVHISTORY_MAX_CHAN];
+	double	sample[PVHISTORY_MAX_CHAN];
+} pvHistoryPvt;
+
+/* copy the history to the output arrays, newest sample first */
+static void pvHistoryPublish(aSubRecord *pasub, pvHistoryPvt *ppvt)
+{
+	double	*valb = (double *)pasub->valb;
+	double	*valc = (double *)pasub->valc;
+	double	t0;
+	const double scale = 1.0/3600;
+	long	i, n;
+
+	n = ppvt->pstore->size;
+	pvHistoryStoreCopy(ppvt->pstore, valb, ppvt->out, n);
+
+	/* the time axis the others are relative to */
+	t0 = valb[0];
+	if (pasub->ftva == menuFtypeDOUBLE) *(double *)pasub->vala = t0;
+
+	/* hours relative to the newest sample, if anybody wants them */
+	if (pasub->novc >= n) {
+		for (i=0; i<n; i++) valc[i] = (valb[i] - t0)*scale;
+	}
+
+	/* With EFLG=NEVER the record doesn't compare the arrays to find out
+	 * whether they changed, and leaves posting them to us. */
+	if (pasub->eflg != aSubEFLG_NEVER) return;
+	if (pasub->ftva == menuFtypeDOUBLE)
+		db_post_events(pasub, pasub->vala, DBE_VALUE|DBE_LOG);
+	db_post_events(pasub, pasub->valb, DBE_VALUE|DBE_LOG);
+	if (pasub->novc >= n)
+		db_post_events(pasub, pasub->valc, DBE_VALUE|DBE_LOG);
+	for (i=0; i<ppvt->pstore->nchan; i++)
+		db_post_events(pasub, (&pasub->vald)[i], DBE_VALUE|DBE_LOG);
+}
+
+/* Take whatever is in the output arrays, e.g. restored by autosave, as the
+ * history so far, unless the history was kept in a file.  Element 0 is the
+ * newest sample.
+ */
+static void pvHistoryLoad(aSubRecord *pasub, pvHistoryPvt *ppvt)
+{
+	ppvt->loaded = 1;
+	if (ppvt->pstore->count > 0) return;
+	if (((double *)pasub->valb)[0] == 0.0) return;
+	pvHistoryStoreLoad(ppvt->pstore, (double *)pasub->valb,
+		(const double **)ppvt->out, ppvt->pstore->size);
+}
+
 static long pvHistory_init(aSubRecord *pasub)
 {
-	double	*valb, *valc;
-	double	*vald, *vale, *valf;
-	long   	i, n;
-
-	valb = (double *)pasub->valb;
-	valc = (double *)pasub->valc;
-	vald = (double *)pasub->vald;
-	vale = (double *)pasub->vale;
-	valf = (double *)pasub->valf;
+	pvHistoryPvt *ppvt;
+	long	n;
+	int		j, nchan;
+
 	n = pasub->novb;
-	for (i=0; i<n; i++) {
-		valb[i] = 0.0;
-		valc[i] = 0.0;
-		vald[i] = 0.0;
-		vale[i] = 0.0;
-		valf[i] = 0.0;
+	for (nchan=0; nchan<PVHISTORY_MAX_CHAN; nchan++) {
+		if ((&pasub->ftd)[nchan] != menuFtypeDOUBLE ||
+			(&pasub->ftvd)[nchan] != menuFtypeDOUBLE ||
+			(&pasub->novd)[nchan] < n) break;
+	}
+	if (nchan == 0) {
+		printf("pvHistory_init: %s has no channels\n", pasub->name);
+		return(-1);
 	}
+
+	ppvt = (pvHistoryPvt *)callocMustSucceed(1, sizeof(pvHistoryPvt),
+		"pvHistory_init");
+	ppvt->pstore = pvHistoryStoreCreate(pasub->name, nchan, n);
+	for (j=0; j<nchan; j++) ppvt->out[j] = (double *)(&pasub->vald)[j];
+	pasub->dpvt = ppvt;
+
+	pvHistoryPublish(pasub, ppvt);
 	return(0);
 }
+
 static long pvHistory(aSubRecord *pasub)
 {
-	double	*b, *valb, *valc;
-	double	*d, *vald, *e, *vale, *f, *valf;
-	long   	*a, i, n;
+	pvHistoryPvt *ppvt = (pvHistoryPvt *)pasub->dpvt;
+	double	*b, *c;
+	long   	*a;
+	int		j;
 
-	n = pasub->novb;	/* max elements of arrays */
+	if (ppvt == NULL) return(-1);
+	if (!ppvt->loaded) pvHistoryLoad(pasub, ppvt);
 	a = (long *)pasub->a;
 	b = (double *)pasub->b; /* current secsPastEpoch */
-	d = (double *)pasub->d; /* current PV value */
-	e = (double *)pasub->e; /* current PV value */
-	f = (double *)pasub->f; /* current PV value */
-	valb = (double *)pasub->valb; /* array of b values */
-	valc = (double *)pasub->valc; /* (valb[] - curr_time), in hours */
-	vald = (double *)pasub->vald; /* recorded PV value array */
-	vale = (double *)pasub->vale; /* recorded PV value array */
-	valf = (double *)pasub->valf; /* recorded PV value array */
+	c = (double *)pasub->c; /* publish period, in seconds */
 	/* clear everything */
 	if (*a) {
-		for(i=0; i<n; i++) {
-			valb[i] = *b;
-			valc[i] = 0.0;
-			vald[i] = 0.0;
-			vale[i] = 0.0;
-			valf[i] = 0.0;
-		}
+		pvHistoryStoreClear(ppvt->pstore, *b);
 		*a = 0;
 	} else {
-		/* shift array contents to next higher index */
-		for (i=n-1; i>0; i--) {
-			valb[i] = valb[i-1];
-			vald[i] = vald[i-1];
-			vale[i] = vale[i-1];
-			valf[i] = valf[i-1];
-		}
-		valb[0] = *b; /* record current secsPastEpoch */
-		valc[0] = 0.0;
-		vald[0] = *d;
-		vale[0] = *e;
-		valf[0] = *f;
-		/* repeat last valid entry to end of array */
-		for (i=1; i<n; i++) {
-			if (valb[i] == 0) valb[i] = valb[i-1];
-		}
+		for (j=0; j<ppvt->pstore->nchan; j++)
+			ppvt->sample[j] = *(double *)(&pasub->d)[j]; /* current PV value */
+		pvHistoryStoreAdd(ppvt->pstore, *b, ppvt->sample);
 		if (pvHistoryDebug) printf("pvHistory: secsPastEpoch=%f\n", *b);
 
-		for (i=1; i<n; i++) {
-			valc[i] = (valb[i]==0)?valc[i-1]:(valb[i] - valb[0])/3600;
-		}
+		/* hold the outputs until the publish period has passed */
+		if (*c > 0.0 && *b - ppvt->publish_time < *c) return(0);
+	}
+	pvHistoryPublish(pasub, ppvt);
+	ppvt->publish_time = *b;
+	return(0);
+}
+
+/* Find the history named by A, which is a STRING, or a CHAR array for names
+ * longer than 39 characters.  A failed lookup puts the record in alarm, and
+ * is logged unless the record was already in alarm for it.
+ */
+static pvHistoryStore *pvHistoryFind(aSubRecord *pasub, const char *routine)
+{
+	pvHistoryStore *pstore;
+	char	name[PVNAME_STRINGSZ];
+	size_t	n;
+
+	if (pasub->fta == menuFtypeSTRING) {
+		n = MAX_STRING_SIZE;
+	} else if (pasub->fta == menuFtypeCHAR) {
+		n = pasub->noa;
+	} else {
+		return(NULL);
+	}
+	n = MIN(n, sizeof(name) - 1);
+	strncpy(name, (char *)pasub->a, n);
+	name[n] = '\0';
+
+	pstore = pvHistoryStoreFind(name);
+	if (pstore == NULL) {
+		if (pasub->stat != READ_ALARM)
+			printf("%s: %s: no history \"%s\"\n", routine, pasub->name,
+				name);
+		recGblSetSevr(pasub, READ_ALARM, INVALID_ALARM);
+	}
+	return(pstore);
+}
+
+/* Publish one tier of a history.  The history is found when this is first
+ * processed, since its record may be initialized after this one.
+ */
+static long pvHistoryTier(aSubRecord *pasub)
+{
+	pvHistoryStore *pstore = (pvHistoryStore *)pasub->dpvt;
+	double	*stats[PVHISTORY_NSTATS];
+	long	n, count;
+	int		i;
+
+	if (pasub->ftb != menuFtypeLONG || pasub->ftc != menuFtypeLONG ||
+		pasub->ftva != menuFtypeDOUBLE)
+		return(-1);
+	if (pstore == NULL) {
+		pstore = pvHistoryFind(pasub, "pvHistoryTier");
+		if (pstore == NULL) return(-1);
+		pasub->dpvt = pstore;
 	}
+
+	n = pasub->nova;
+	for (i=0; i<PVHISTORY_NSTATS; i++) {
+		if ((&pasub->ftvb)[i] == menuFtypeDOUBLE && (&pasub->novb)[i] >= n)
+			stats[i] = (double *)(&pasub->valb)[i];
+		else
+			stats[i] = NULL;
+	}
+	count = pvHistoryStoreTierCopy(pstore, *(epicsInt32 *)pasub->b,
+		*(epicsInt32 *)pasub->c, (double *)pasub->vala, stats, n);
+	if (count < 0) return(-1);
+	if (pvHistoryDebug) printf("pvHistoryTier: %ld bins\n", count);
+	return(0);
+}
+
+/* Publish a time range of a history, found as by pvHistoryTier */
+static long pvHistoryQuery(aSubRecord *pasub)
+{
+	pvHistoryStore *pstore = (pvHistoryStore *)pasub->dpvt;
+	double	*values[PVHISTORY_MAX_CHAN];
+	long	n, count;
+	int		j;
+
+	if (pasub->ftb != menuFtypeDOUBLE || pasub->ftc != menuFtypeDOUBLE ||
+		pasub->ftd != menuFtypeLONG || pasub->ftva != menuFtypeDOUBLE)
+		return(-1);
+	if (pstore == NULL) {
+		pstore = pvHistoryFind(pasub, "pvHistoryQuery");
+		if (pstore == NULL) return(-1);
+		pasub->dpvt = pstore;
+	}
+
+	n = pasub->nova;
+	for (j=0; j<pstore->nchan && j<PVHISTORY_MAX_CHAN; j++) {
+		if ((&pasub->ftvb)[j] == menuFtypeDOUBLE && (&pasub->novb)[j] >= n)
+			values[j] = (double *)(&pasub->valb)[j];
+		else
+			values[j] = NULL;
+	}
+	for (; j<pstore->nchan; j++) values[j] = NULL;
+
+	count = pvHistoryStoreQuery(pstore, *(double *)pasub->b,
+		*(double *)pasub->c, *(epicsInt32 *)pasub->d, (double *)pasub->vala,
+		values, n);
+#if !LT_EPICSBASE(3,15,0,2)
+	pasub->neva = count;
+	for (j=0; j<pstore->nchan && j<PVHISTORY_MAX_CHAN; j++)
+		if (values[j]) (&pasub->nevb)[j] = count;
+#endif
+	if (pvHistoryDebug) printf("pvHistoryQuery: %ld samples\n", count);
 	return(0);
 }
 
@@ -95,7 +297,9 @@ epicsExportAddress(int, pvHistoryDebug);
 
 static registryFunctionRef pvHistoryRef[] = {
 	{"pvHistory_init", (REGISTRYFUNCTION)pvHistory_init},
-	{"pvHistory", (REGISTRYFUNCTION)pvHistory}
+	{"pvHistory", (REGISTRYFUNCTION)pvHistory},
+	{"pvHistoryTier", (REGISTRYFUNCTION)pvHistoryTier},
+	{"pvHistoryQuery", (REGISTRYFUNCTION)pvHistoryQuery}
 };
 
 static void pvHistoryRegister(void) {
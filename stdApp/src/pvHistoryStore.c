@@ -0,0 +1,1395 @@
+/* pvHistoryStore.c - Sample history of a group of PVs sharing a time axis */
+/*
+ * iocsh commands:
+ *   pvHistoryTierConfig(name, interval, bins)  add a tier to the store of
+ *                                              record name, before iocInit
+ *   pvHistoryFileConfig(name, path, sync)      keep the store of record
+ *                                              name in a file, before iocInit
+ *   pvHistoryCompressConfig(name, chan, mode, tolerance)
+ *                                              compress a channel of the
+ *                                              store of record name
+ *   pvHistoryFloatConfig(name, chan)           keep a channel of the store
+ *                                              of record name as floats,
+ *                                              before iocInit
+ *   pvHistoryQuery(name, t0, t1, points)       print the samples of a
+ *                                              time range
+ *   pvHistoryReport(level)                     show the stores
+ *
+ * Modification Log:
+ * -----------------
+ * 10/19/26  AG  First version, from the ring buffer in pvHistory.c.  Any
+ *               number of channels, stored as columns of one block.
+ * 10/19/26  AG  Tiers of bins holding the min, max, mean and count of the
+ *               samples in a fixed interval.
+ * 10/19/26  AG  A store is one block of memory, laid out as a header, the ring
+ *               state and the columns.  The block can be a memory-mapped file,
+ *               which the store re-attaches to when the IOC restarts.
+ * 10/19/26  AG  Deadband and swinging door compression.  The sample held by
+ *               the compression is kept in the block, layout 2.
+ * 10/19/26  AG  Time range queries, decimated keeping the min and max.
+ * 10/19/26  AG  Min, max, mean and standard deviation over a window, computed
+ *               in one pass over each contiguous part of the columns.
+ * 10/19/26  AG  The time column holds 32-bit offsets from a base time, and
+ *               channels can be kept as floats, layout 3.
+ * 10/19/26  AG  pvHistoryStoreLoad skips the fill after the last sample.
+ * 10/19/26  AG  The window standard deviation is the sample one, over n-1,
+ *               as for DTSD of the epid record.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <dbDefs.h>
+#include <cantProceed.h>
+#include <epicsString.h>
+#include <epicsTypes.h>
+#include <epicsExit.h>
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include "pvHistoryStore.h"
+
+#if !defined(_WIN32) && !defined(vxWorks) && !defined(__rtems__)
+#define PVHISTORY_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+#define MIN(a,b) ((a) > (b) ? (b) : (a))
+
+/* the tiers asked for with pvHistoryTierConfig */
+typedef struct tierConfig {
+	ELLNODE	node;
+	char	*name;
+	double	interval;
+	long	bins;
+} tierConfig;
+
+/* the files asked for with pvHistoryFileConfig */
+typedef struct fileConfig {
+	ELLNODE	node;
+	char	*name;
+	char	*path;
+	double	sync_period;
+} fileConfig;
+
+/* the float channels asked for with pvHistoryFloatConfig */
+typedef struct floatConfig {
+	ELLNODE	node;
+	char	*name;
+	int		chan;			/* -1 for all channels */
+} floatConfig;
+
+/* the compression asked for with pvHistoryCompressConfig */
+typedef struct compressConfig {
+	ELLNODE	node;
+	char	*name;
+	int		chan;			/* -1 for all channels */
+	pvHistoryCompressMode mode;
+	double	tolerance;
+} compressConfig;
+
+static const char *compressModeNames[] = {
+	"none", "deadband", "relative", "swingingDoor"
+};
+
+static ELLLIST tierConfigList = ELLLIST_INIT;
+static ELLLIST fileConfigList = ELLLIST_INIT;
+static ELLLIST compressConfigList = ELLLIST_INIT;
+static ELLLIST floatConfigList = ELLLIST_INIT;
+static ELLLIST storeList = ELLLIST_INIT;
+
+/* The block of a store starts with a storeHeader, followed by a
+ * headerTier for each tier and a flag for each channel that is 1 if it is
+ * kept as floats.  Then come the sample held by the compression (its time
+ * and values), the time column and the value columns of the samples, and
+ * for each tier its time and stats columns and the bin being filled.  Only
+ * fixed size types are used, and each part is padded to a multiple of 8
+ * bytes, so that the block can be kept in a file.  Any change to the
+ * layout must change PVHISTORY_LAYOUT.
+ */
+#define PVHISTORY_MAGIC		"pvHist\r\n"
+#define PVHISTORY_LAYOUT	3
+
+#define PAD8(bytes)	(((bytes) + 7) & ~(size_t)7)
+
+/* The time offsets are in milliseconds, unless the history spans more
+ * than 2^32 of them.
+ */
+#define PVHISTORY_TIME_UNIT	1.e-3
+#define PVHISTORY_TIME_MAX	4294967295.0
+
+typedef struct storeHeader {
+	char	magic[8];
+	epicsUInt32 layout;
+	epicsUInt32 nchan;
+	epicsUInt32 size;
+	epicsUInt32 ntier;
+	/* ring state */
+	epicsInt32 head;
+	epicsInt32 count;
+	double	fill_time;
+	epicsInt32 held;		/* a sample is held by the compression */
+	epicsInt32 spare;
+	double	time_base;
+	double	time_unit;
+} storeHeader;
+
+typedef struct headerTier {
+	double	interval;
+	epicsUInt32 size;
+	epicsInt32 head;
+	epicsInt32 count;
+	epicsInt32 nbin;
+	double	bin;
+} headerTier;
+
+/* the column of one statistic of one channel in a tier */
+#define tierColumn(ptier, chan, stat) \
+	((ptier)->stats + ((chan)*PVHISTORY_NSTATS + (stat))*(ptier)->size)
+
+/* the ring index in front of head */
+#define ringNext(head, size) ((head) == 0 ? (size) - 1 : (head) - 1)
+
+static void tierClear(pvHistoryStoreTier *ptier)
+{
+	ptier->head = 0;
+	ptier->count = 0;
+	ptier->nbin = 0;
+}
+
+/* move the bin being filled into the ring */
+static void tierClose(pvHistoryStore *pstore, pvHistoryStoreTier *ptier)
+{
+	double	*acc = ptier->acc;
+	long	head;
+	int		j;
+
+	head = ringNext(ptier->head, ptier->size);
+	ptier->head = head;
+	if (ptier->count < ptier->size) ptier->count++;
+
+	ptier->time[head] = ptier->bin * ptier->interval;
+	for (j=0; j<pstore->nchan; j++, acc += 3) {
+		tierColumn(ptier, j, pvHistoryMin)[head] = acc[0];
+		tierColumn(ptier, j, pvHistoryMax)[head] = acc[1];
+		tierColumn(ptier, j, pvHistoryMean)[head] = acc[2] / ptier->nbin;
+		tierColumn(ptier, j, pvHistoryCount)[head] = ptier->nbin;
+	}
+	ptier->nbin = 0;
+}
+
+static void tierAdd(pvHistoryStore *pstore, pvHistoryStoreTier *ptier,
+	double time, const double *values)
+{
+	double	*acc = ptier->acc;
+	double	bin;
+	int		j;
+
+	bin = floor(time / ptier->interval);
+	if (ptier->nbin > 0 && bin != ptier->bin) tierClose(pstore, ptier);
+
+	if (ptier->nbin == 0) {
+		ptier->bin = bin;
+		for (j=0; j<pstore->nchan; j++, acc += 3) {
+			acc[0] = acc[1] = values[j];
+			acc[2] = 0.0;
+		}
+		acc = ptier->acc;
+	}
+	for (j=0; j<pstore->nchan; j++, acc += 3) {
+		if (values[j] < acc[0]) acc[0] = values[j];
+		if (values[j] > acc[1]) acc[1] = values[j];
+		acc[2] += values[j];
+	}
+	ptier->nbin++;
+}
+
+/* the time and value of element k of the ring */
+#define timeGet(pstore, k) \
+	((pstore)->time_base + (pstore)->time[k] * (pstore)->time_unit)
+
+static double columnGet(pvHistoryStore *pstore, int chan, long k)
+{
+	if (pstore->single[chan]) return(((float *)pstore->column[chan])[k]);
+	return(((double *)pstore->column[chan])[k]);
+}
+
+static void columnSet(pvHistoryStore *pstore, int chan, long k, double value)
+{
+	if (pstore->single[chan])
+		((float *)pstore->column[chan])[k] = (float)value;
+	else
+		((double *)pstore->column[chan])[k] = value;
+}
+
+/* Move the time offsets of the samples in the ring to a new base, shift
+ * steps later, and to steps of unit seconds.
+ */
+static void timeRescale(pvHistoryStore *pstore, double shift, double unit)
+{
+	double	scale = pstore->time_unit / unit;
+	long	i, k;
+
+	for (i=0, k=pstore->head; i<pstore->count; i++) {
+		pstore->time[k] = (epicsUInt32)floor((pstore->time[k] - shift)*scale
+			+ 0.5);
+		if (++k == pstore->size) k = 0;
+	}
+	pstore->time_base += shift * pstore->time_unit;
+	pstore->time_unit = unit;
+}
+
+/* The time offset of a new sample.  If it doesn't fit, the base is moved
+ * to the oldest time in the ring, and the steps are made as short as the
+ * span of the times allows.  A history with longer steps is looked at
+ * again each time the ring goes round, to get its resolution back once
+ * the old samples are gone.
+ */
+static epicsUInt32 timeEncode(pvHistoryStore *pstore, double time)
+{
+	double	steps, lo, hi, unit = PVHISTORY_TIME_UNIT, scale;
+	long	i, k;
+
+	if (pstore->count == 0) {
+		pstore->time_base = time;
+		pstore->time_unit = PVHISTORY_TIME_UNIT;
+		return(0);
+	}
+	steps = floor((time - pstore->time_base)/pstore->time_unit + 0.5);
+	if (steps >= 0.0 && steps <= PVHISTORY_TIME_MAX &&
+		(pstore->time_unit == PVHISTORY_TIME_UNIT || pstore->head != 0))
+		return((epicsUInt32)steps);
+
+	/* the times aren't always in order, e.g. after a clock change */
+	lo = hi = steps;
+	for (i=0, k=pstore->head; i<pstore->count; i++) {
+		if (pstore->time[k] < lo) lo = pstore->time[k];
+		if (pstore->time[k] > hi) hi = pstore->time[k];
+		if (++k == pstore->size) k = 0;
+	}
+	while ((hi - lo)*pstore->time_unit/unit + 0.5 > PVHISTORY_TIME_MAX)
+		unit *= 2.0;
+	scale = pstore->time_unit / unit;
+	timeRescale(pstore, lo, unit);
+	return((epicsUInt32)floor((steps - lo)*scale + 0.5));
+}
+
+/* put a row into the ring */
+static void ringAdd(pvHistoryStore *pstore, double time, const double *values)
+{
+	epicsUInt32 offset;
+	long	head;
+	int		j;
+
+	offset = timeEncode(pstore, time);
+
+	/* the new sample goes in front of the newest one */
+	head = ringNext(pstore->head, pstore->size);
+	pstore->head = head;
+	if (pstore->count < pstore->size) pstore->count++;
+
+	pstore->time[head] = offset;
+	for (j=0; j<pstore->nchan; j++) columnSet(pstore, j, head, values[j]);
+}
+
+/* the row just stored is where the compression of every channel restarts */
+static void compressRestart(pvHistoryStore *pstore, double time,
+	const double *values)
+{
+	pvHistoryCompress *pcomp = pstore->compress;
+	int		j;
+
+	for (j=0; j<pstore->nchan; j++, pcomp++) {
+		pcomp->ref = values[j];
+		pcomp->ref_time = time;
+		pcomp->upper = HUGE_VAL;
+		pcomp->lower = -HUGE_VAL;
+	}
+	pstore->nheld = 0;
+}
+
+/* restart the compression from the newest row, e.g. after a restart */
+static void compressFromNewest(pvHistoryStore *pstore)
+{
+	double	*sample = pstore->held + 1;
+	int		j;
+
+	/* a held sample is stored, since the doors it narrowed are lost */
+	if (pstore->nheld) ringAdd(pstore, pstore->held[0], pstore->held + 1);
+	if (pstore->count == 0) {
+		pstore->nheld = 0;
+		return;
+	}
+	for (j=0; j<pstore->nchan; j++)
+		sample[j] = columnGet(pstore, j, pstore->head);
+	compressRestart(pstore, timeGet(pstore, pstore->head), sample);
+}
+
+/* set the compression of one channel, or of all with chan -1 */
+static void compressSet(pvHistoryStore *pstore, int chan,
+	pvHistoryCompressMode mode, double tolerance)
+{
+	int		j;
+
+	for (j=0; j<pstore->nchan; j++) {
+		if (chan >= 0 && j != chan) continue;
+		pstore->compress[j].mode = mode;
+		pstore->compress[j].tolerance = tolerance;
+	}
+}
+
+/* bytes needed for the block of a store */
+static size_t blockBytes(pvHistoryStore *pstore)
+{
+	size_t	bytes;
+	int		i;
+
+	bytes = sizeof(storeHeader) + pstore->ntier * sizeof(headerTier);
+	bytes += PAD8(pstore->nchan * sizeof(epicsUInt32));
+	bytes += (pstore->nchan + 1) * sizeof(double);
+	bytes += PAD8(pstore->size * sizeof(epicsUInt32));
+	for (i=0; i<pstore->nchan; i++)
+		bytes += PAD8(pstore->size *
+			(pstore->single[i] ? sizeof(float) : sizeof(double)));
+	for (i=0; i<pstore->ntier; i++) {
+		bytes += (pstore->nchan*PVHISTORY_NSTATS + 1) * pstore->tier[i].size *
+			sizeof(double);
+		bytes += 3 * pstore->nchan * sizeof(double);
+	}
+	return(bytes);
+}
+
+/* point the columns of a store into its block */
+static void blockLayout(pvHistoryStore *pstore)
+{
+	pvHistoryStoreTier *ptier;
+	char	*pos;
+	double	*next;
+	int		i;
+
+	pos = (char *)pstore->block + sizeof(storeHeader) +
+		pstore->ntier * sizeof(headerTier) +
+		PAD8(pstore->nchan * sizeof(epicsUInt32));
+	pstore->held = (double *)pos;
+	pos += (pstore->nchan + 1) * sizeof(double);
+	pstore->time = (epicsUInt32 *)pos;
+	pos += PAD8(pstore->size * sizeof(epicsUInt32));
+	for (i=0; i<pstore->nchan; i++) {
+		pstore->column[i] = pos;
+		pos += PAD8(pstore->size *
+			(pstore->single[i] ? sizeof(float) : sizeof(double)));
+	}
+	next = (double *)pos;
+	for (i=0; i<pstore->ntier; i++) {
+		ptier = &pstore->tier[i];
+		ptier->time = next;
+		ptier->stats = ptier->time + ptier->size;
+		ptier->acc = ptier->stats + pstore->nchan*PVHISTORY_NSTATS*ptier->size;
+		next = ptier->acc + 3*pstore->nchan;
+	}
+}
+
+/* write the ring state into the header */
+static void headerSave(pvHistoryStore *pstore)
+{
+	storeHeader *phead = (storeHeader *)pstore->block;
+	headerTier *ptiers = (headerTier *)(phead + 1);
+	pvHistoryStoreTier *ptier;
+	int		i;
+
+	phead->head = pstore->head;
+	phead->count = pstore->count;
+	phead->fill_time = pstore->fill_time;
+	phead->held = pstore->nheld;
+	phead->time_base = pstore->time_base;
+	phead->time_unit = pstore->time_unit;
+	for (i=0; i<pstore->ntier; i++) {
+		ptier = &pstore->tier[i];
+		ptiers[i].head = ptier->head;
+		ptiers[i].count = ptier->count;
+		ptiers[i].nbin = ptier->nbin;
+		ptiers[i].bin = ptier->bin;
+	}
+}
+
+/* write a new header for an empty store */
+static void headerInit(pvHistoryStore *pstore)
+{
+	storeHeader *phead = (storeHeader *)pstore->block;
+	headerTier *ptiers = (headerTier *)(phead + 1);
+	epicsUInt32 *single = (epicsUInt32 *)(ptiers + pstore->ntier);
+	int		i;
+
+	memset(pstore->block, 0, pstore->bytes);
+	memcpy(phead->magic, PVHISTORY_MAGIC, sizeof(phead->magic));
+	phead->layout = PVHISTORY_LAYOUT;
+	phead->nchan = pstore->nchan;
+	phead->size = pstore->size;
+	phead->ntier = pstore->ntier;
+	for (i=0; i<pstore->ntier; i++) {
+		ptiers[i].interval = pstore->tier[i].interval;
+		ptiers[i].size = pstore->tier[i].size;
+	}
+	for (i=0; i<pstore->nchan; i++) single[i] = pstore->single[i];
+	headerSave(pstore);
+}
+
+/* Take the ring state from the header of an existing block.  Returns 0,
+ * or -1 if the block was written with a different layout or configuration.
+ */
+static int headerLoad(pvHistoryStore *pstore)
+{
+	storeHeader *phead = (storeHeader *)pstore->block;
+	headerTier *ptiers = (headerTier *)(phead + 1);
+	epicsUInt32 *single = (epicsUInt32 *)(ptiers + pstore->ntier);
+	pvHistoryStoreTier *ptier;
+	int		i;
+
+	if (memcmp(phead->magic, PVHISTORY_MAGIC, sizeof(phead->magic)) ||
+		phead->layout != PVHISTORY_LAYOUT || phead->nchan != pstore->nchan ||
+		phead->size != pstore->size || phead->ntier != pstore->ntier ||
+		phead->head < 0 || phead->head >= pstore->size ||
+		phead->count < 0 || phead->count > pstore->size ||
+		(phead->count > 0 && !(phead->time_unit > 0.0)))
+		return(-1);
+	for (i=0; i<pstore->nchan; i++)
+		if (single[i] != (epicsUInt32)pstore->single[i]) return(-1);
+	for (i=0; i<pstore->ntier; i++) {
+		ptier = &pstore->tier[i];
+		if (ptiers[i].interval != ptier->interval ||
+			ptiers[i].size != ptier->size || ptiers[i].head < 0 ||
+			ptiers[i].head >= ptier->size || ptiers[i].count < 0 ||
+			ptiers[i].count > ptier->size || ptiers[i].nbin < 0)
+			return(-1);
+	}
+
+	pstore->head = phead->head;
+	pstore->count = phead->count;
+	pstore->fill_time = phead->fill_time;
+	pstore->nheld = (phead->held != 0);
+	pstore->time_base = phead->time_base;
+	pstore->time_unit = phead->time_unit;
+	for (i=0; i<pstore->ntier; i++) {
+		ptier = &pstore->tier[i];
+		ptier->head = ptiers[i].head;
+		ptier->count = ptiers[i].count;
+		ptier->nbin = ptiers[i].nbin;
+		ptier->bin = ptiers[i].bin;
+	}
+	return(0);
+}
+
+#ifdef PVHISTORY_MMAP
+/* Map the file as the block of the store, re-attaching to the history in
+ * it if it was written for the same configuration.  Returns 0, or -1 if
+ * the store has to do without the file.
+ */
+static int fileAttach(pvHistoryStore *pstore, fileConfig *pfile)
+{
+	struct stat st;
+	void	*block;
+	int		fd, attach;
+
+	fd = open(pfile->path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		printf("pvHistoryStoreCreate: %s: can't open %s\n", pstore->name,
+			pfile->path);
+		if (fd >= 0) close(fd);
+		return(-1);
+	}
+	attach = (st.st_size == (off_t)pstore->bytes);
+	if (!attach && ftruncate(fd, pstore->bytes) != 0) {
+		printf("pvHistoryStoreCreate: %s: can't size %s\n", pstore->name,
+			pfile->path);
+		close(fd);
+		return(-1);
+	}
+	block = mmap(NULL, pstore->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (block == MAP_FAILED) {
+		printf("pvHistoryStoreCreate: %s: can't map %s\n", pstore->name,
+			pfile->path);
+		return(-1);
+	}
+
+	pstore->block = block;
+	pstore->mapped = 1;
+	pstore->sync_period = pfile->sync_period;
+	blockLayout(pstore);
+	if (attach && headerLoad(pstore) == 0) return(0);
+
+	if (st.st_size != 0)
+		printf("pvHistoryStoreCreate: %s: %s doesn't match the "
+			"configuration, starting a new history\n", pstore->name,
+			pfile->path);
+	headerInit(pstore);
+	return(0);
+}
+
+static void fileSync(pvHistoryStore *pstore, int flags)
+{
+	msync(pstore->block, pstore->bytes, flags);
+}
+
+static void storeExit(void *arg)
+{
+	pvHistoryStore *pstore;
+
+	for (pstore = (pvHistoryStore *)ellFirst(&storeList); pstore;
+		pstore = (pvHistoryStore *)ellNext(&pstore->node)) {
+		if (!pstore->mapped) continue;
+		epicsMutexMustLock(pstore->lock);
+		fileSync(pstore, MS_SYNC);
+		epicsMutexUnlock(pstore->lock);
+	}
+}
+#endif
+
+pvHistoryStore *pvHistoryStoreCreate(const char *name, int nchan, long size)
+{
+	pvHistoryStore *pstore;
+	pvHistoryStoreTier *ptier;
+	tierConfig *pconfig;
+	fileConfig *pfile;
+	compressConfig *pcomp;
+	floatConfig *pfloat;
+	int		ntier = 0, j;
+#ifdef PVHISTORY_MMAP
+	static int exitAdded = 0;
+#endif
+
+	for (pconfig = (tierConfig *)ellFirst(&tierConfigList); pconfig;
+		pconfig = (tierConfig *)ellNext(&pconfig->node))
+		if (!strcmp(pconfig->name, name)) ntier++;
+
+	pstore = (pvHistoryStore *)callocMustSucceed(1, sizeof(pvHistoryStore),
+		"pvHistoryStoreCreate");
+	pstore->name = epicsStrDup(name);
+	pstore->lock = epicsMutexMustCreate();
+	pstore->nchan = nchan;
+	pstore->size = size;
+	pstore->column = (void **)callocMustSucceed(nchan, sizeof(void *),
+		"pvHistoryStoreCreate");
+	pstore->single = (int *)callocMustSucceed(nchan, sizeof(int),
+		"pvHistoryStoreCreate");
+	for (pfloat = (floatConfig *)ellFirst(&floatConfigList); pfloat;
+		pfloat = (floatConfig *)ellNext(&pfloat->node)) {
+		if (strcmp(pfloat->name, name)) continue;
+		for (j=0; j<nchan; j++)
+			if (pfloat->chan < 0 || pfloat->chan == j) pstore->single[j] = 1;
+	}
+
+	if (ntier) {
+		pstore->tier = (pvHistoryStoreTier *)callocMustSucceed(ntier,
+			sizeof(pvHistoryStoreTier), "pvHistoryStoreCreate");
+		for (pconfig = (tierConfig *)ellFirst(&tierConfigList); pconfig;
+			pconfig = (tierConfig *)ellNext(&pconfig->node)) {
+			if (strcmp(pconfig->name, name)) continue;
+			ptier = &pstore->tier[pstore->ntier++];
+			ptier->interval = pconfig->interval;
+			ptier->size = pconfig->bins;
+		}
+	}
+	pstore->bytes = blockBytes(pstore);
+	pstore->compress = (pvHistoryCompress *)callocMustSucceed(nchan,
+		sizeof(pvHistoryCompress), "pvHistoryStoreCreate");
+	for (pcomp = (compressConfig *)ellFirst(&compressConfigList); pcomp;
+		pcomp = (compressConfig *)ellNext(&pcomp->node))
+		if (!strcmp(pcomp->name, name))
+			compressSet(pstore, pcomp->chan, pcomp->mode, pcomp->tolerance);
+
+	for (pfile = (fileConfig *)ellFirst(&fileConfigList); pfile;
+		pfile = (fileConfig *)ellNext(&pfile->node))
+		if (!strcmp(pfile->name, name)) break;
+#ifdef PVHISTORY_MMAP
+	if (pfile && fileAttach(pstore, pfile) == 0 && !exitAdded) {
+		epicsAtExit(storeExit, NULL);
+		exitAdded = 1;
+	}
+#else
+	if (pfile)
+		printf("pvHistoryStoreCreate: %s: files are not supported on this "
+			"OS\n", name);
+#endif
+	if (!pstore->mapped) {
+		pstore->block = callocMustSucceed(1, pstore->bytes,
+			"pvHistoryStoreCreate");
+		blockLayout(pstore);
+		headerInit(pstore);
+	}
+
+	compressFromNewest(pstore);
+	headerSave(pstore);
+	ellAdd(&storeList, &pstore->node);
+	return(pstore);
+}
+
+pvHistoryStore *pvHistoryStoreFind(const char *name)
+{
+	pvHistoryStore *pstore;
+
+	for (pstore = (pvHistoryStore *)ellFirst(&storeList); pstore;
+		pstore = (pvHistoryStore *)ellNext(&pstore->node))
+		if (!strcmp(pstore->name, name)) return(pstore);
+	return(NULL);
+}
+
+void pvHistoryStoreClear(pvHistoryStore *pstore, double time)
+{
+	int		i;
+
+	epicsMutexMustLock(pstore->lock);
+	pstore->head = 0;
+	pstore->count = 0;
+	pstore->fill_time = time;
+	pstore->nheld = 0;
+	for (i=0; i<pstore->ntier; i++) tierClear(&pstore->tier[i]);
+	headerSave(pstore);
+	epicsMutexUnlock(pstore->lock);
+}
+
+/* Returns 1 if a deadband channel moved out of its deadband, or a channel
+ * isn't compressed.
+ */
+static int compressDeadband(pvHistoryStore *pstore, const double *values)
+{
+	pvHistoryCompress *pcomp = pstore->compress;
+	double	diff;
+	int		j;
+
+	for (j=0; j<pstore->nchan; j++, pcomp++) {
+		diff = fabs(values[j] - pcomp->ref);
+		switch (pcomp->mode) {
+		case pvHistoryCompressNone:
+			return(1);
+		case pvHistoryCompressDeadband:
+			if (diff > pcomp->tolerance) return(1);
+			break;
+		case pvHistoryCompressRelative:
+			if (diff > pcomp->tolerance * fabs(pcomp->ref)) return(1);
+			break;
+		default:
+			break;
+		}
+	}
+	return(0);
+}
+
+/* With narrow 0, returns 1 if the line from the last stored sample to this
+ * one is outside the swinging door of a channel, so that the held sample
+ * has to be stored.  With narrow 1, narrows the doors to the slopes that
+ * pass within tolerance of this sample.
+ */
+static int compressDoors(pvHistoryStore *pstore, double time,
+	const double *values, int narrow)
+{
+	pvHistoryCompress *pcomp;
+	double	dt, slope, upper, lower;
+	int		j;
+
+	for (j=0, pcomp=pstore->compress; j<pstore->nchan; j++, pcomp++) {
+		if (pcomp->mode != pvHistoryCompressSwingingDoor) continue;
+		dt = time - pcomp->ref_time;
+		if (dt <= 0.0) continue;
+		if (!narrow) {
+			slope = (values[j] - pcomp->ref) / dt;
+			if (slope > pcomp->upper || slope < pcomp->lower) return(1);
+		} else {
+			upper = (values[j] + pcomp->tolerance - pcomp->ref) / dt;
+			lower = (values[j] - pcomp->tolerance - pcomp->ref) / dt;
+			if (upper < pcomp->upper) pcomp->upper = upper;
+			if (lower > pcomp->lower) pcomp->lower = lower;
+		}
+	}
+	return(0);
+}
+
+/* add a row the compression has nothing to say about, e.g. a restored one */
+static void storeAdd(pvHistoryStore *pstore, double time,
+	const double *values)
+{
+	int		i;
+
+	ringAdd(pstore, time, values);
+	for (i=0; i<pstore->ntier; i++)
+		tierAdd(pstore, &pstore->tier[i], time, values);
+}
+
+/* Add a sample.  The tiers see every sample; the ring only those the
+ * compression needs.  A sample the compression doesn't need yet is held,
+ * since a swinging door may close on the next one and need it then.
+ */
+static void sampleAdd(pvHistoryStore *pstore, double time,
+	const double *values)
+{
+	int		i, j;
+
+	for (i=0; i<pstore->ntier; i++)
+		tierAdd(pstore, &pstore->tier[i], time, values);
+	pstore->offered++;
+
+	/* a door that can't let this sample through needs the held one */
+	if (pstore->nheld && compressDoors(pstore, time, values, 0)) {
+		ringAdd(pstore, pstore->held[0], pstore->held + 1);
+		compressRestart(pstore, pstore->held[0], pstore->held + 1);
+	}
+
+	if (pstore->count == 0 || compressDeadband(pstore, values)) {
+		ringAdd(pstore, time, values);
+		compressRestart(pstore, time, values);
+		return;
+	}
+	compressDoors(pstore, time, values, 1);
+
+	pstore->held[0] = time;
+	for (j=0; j<pstore->nchan; j++) pstore->held[j+1] = values[j];
+	pstore->nheld = 1;
+}
+
+void pvHistoryStoreAdd(pvHistoryStore *pstore, double time,
+	const double *values)
+{
+	epicsMutexMustLock(pstore->lock);
+	sampleAdd(pstore, time, values);
+	headerSave(pstore);
+#ifdef PVHISTORY_MMAP
+	if (pstore->mapped && pstore->sync_period > 0.0 &&
+		fabs(time - pstore->sync_time) >= pstore->sync_period) {
+		fileSync(pstore, MS_ASYNC);
+		pstore->sync_time = time;
+	}
+#endif
+	epicsMutexUnlock(pstore->lock);
+}
+
+/* copy count elements of a ring column, newest first: from head to the
+ * end, then the wrapped part
+ */
+static void copyColumn(const double *column, long head, long size,
+	double *out, long count)
+{
+	long	first = MIN(count, size - head);
+
+	memcpy(out, column + head, first * sizeof(double));
+	memcpy(out + first, column, (count - first) * sizeof(double));
+}
+
+/* the same for a column of floats */
+static void copyColumnFloat(const float *column, long head, long size,
+	double *out, long count)
+{
+	long	first = MIN(count, size - head), i;
+
+	for (i=0; i<first; i++) out[i] = column[head + i];
+	for (i=first; i<count; i++) out[i] = column[i - first];
+}
+
+/* the same for the time column, from offsets to seconds past epoch */
+static void copyTimes(pvHistoryStore *pstore, double *out, long count)
+{
+	const epicsUInt32 *column = pstore->time;
+	double	base = pstore->time_base, unit = pstore->time_unit;
+	long	first = MIN(count, pstore->size - pstore->head), i;
+
+	column += pstore->head;
+	for (i=0; i<first; i++) out[i] = base + column[i] * unit;
+	column = pstore->time - first;
+	for (i=first; i<count; i++) out[i] = base + column[i] * unit;
+}
+
+/* repeat the last valid time to the end of the array */
+static void fillTime(pvHistoryStore *pstore, double *time, long count, long n)
+{
+	double	fill;
+	long	i;
+
+	if (pstore->fill_time != 0.0 || count == 0)
+		fill = pstore->fill_time;
+	else
+		fill = time[count - 1];
+	for (i=count; i<n; i++) time[i] = fill;
+}
+
+long pvHistoryStoreCopy(pvHistoryStore *pstore, double *time,
+	double **values, long n)
+{
+	long	i, k, count;
+	int		j;
+
+	epicsMutexMustLock(pstore->lock);
+	/* the held sample, if any, is the newest */
+	k = (pstore->nheld && n > 0) ? 1 : 0;
+	count = MIN(pstore->count, n - k);
+	if (time) {
+		if (k) time[0] = pstore->held[0];
+		copyTimes(pstore, time + k, count);
+		fillTime(pstore, time, count + k, n);
+	}
+	for (j=0; j<pstore->nchan; j++) {
+		if (values[j] == NULL) continue;
+		if (k) values[j][0] = pstore->held[j+1];
+		if (pstore->single[j])
+			copyColumnFloat((float *)pstore->column[j], pstore->head,
+				pstore->size, values[j] + k, count);
+		else
+			copyColumn((double *)pstore->column[j], pstore->head,
+				pstore->size, values[j] + k, count);
+		for (i=count+k; i<n; i++) values[j][i] = 0.0;
+	}
+	epicsMutexUnlock(pstore->lock);
+	return(count + k);
+}
+
+/* The number of samples in arrays left by pvHistoryStoreCopy.  The fill
+ * after the last sample has the value 0 and repeats one time: that of the
+ * oldest sample, or of the last clear.  Either way the first element with
+ * the last time ends the samples, and is itself one unless all its values
+ * are 0.  Elements with no time at all were never written.
+ */
+static long loadCount(int nchan, const double *time, const double **values,
+	long n)
+{
+	long	i, first;
+	int		j;
+
+	for (i=0; i<n && time[i] != 0.0; i++);
+	n = i;
+	if (n == 0) return(0);
+	for (first=0; time[first] != time[n - 1]; first++);
+	if (first == n - 1) return(n);
+	for (j=0; j<nchan; j++)
+		if (values[j][first] != 0.0) return(first + 1);
+	return(first);
+}
+
+void pvHistoryStoreLoad(pvHistoryStore *pstore, const double *time,
+	const double **values, long n)
+{
+	double	*sample;
+	long	i;
+	int		j;
+
+	n = loadCount(pstore->nchan, time, values, MIN(n, pstore->size));
+	sample = (double *)callocMustSucceed(pstore->nchan, sizeof(double),
+		"pvHistoryStoreLoad");
+
+	epicsMutexMustLock(pstore->lock);
+	pstore->head = 0;
+	pstore->count = 0;
+	for (i=0; i<pstore->ntier; i++) tierClear(&pstore->tier[i]);
+	/* oldest first, so that the tiers see them in order */
+	for (i=n-1; i>=0; i--) {
+		for (j=0; j<pstore->nchan; j++) sample[j] = values[j][i];
+		storeAdd(pstore, time[i], sample);
+	}
+	pstore->nheld = 0;
+	compressFromNewest(pstore);
+	headerSave(pstore);
+	epicsMutexUnlock(pstore->lock);
+	free(sample);
+}
+
+/* The samples by age, 0 being the newest: the held sample, if any, then
+ * the ring from head on.
+ */
+static long ringAt(pvHistoryStore *pstore, long i)
+{
+	if (pstore->nheld) i--;
+	i += pstore->head;
+	return(i < pstore->size ? i : i - pstore->size);
+}
+
+static double timeAt(pvHistoryStore *pstore, long i)
+{
+	if (pstore->nheld && i == 0) return(pstore->held[0]);
+	return(timeGet(pstore, ringAt(pstore, i)));
+}
+
+static double valueAt(pvHistoryStore *pstore, int chan, long i)
+{
+	if (pstore->nheld && i == 0) return(pstore->held[chan+1]);
+	return(columnGet(pstore, chan, ringAt(pstore, i)));
+}
+
+/* the first sample, by age, whose time is before time (or at it, with
+ * at 1).  The times get older with age, so this is a binary search.
+ */
+static long sampleSearch(pvHistoryStore *pstore, long nsamples, double time,
+	int at)
+{
+	long	lo = 0, hi = nsamples, mid;
+	double	t;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo)/2;
+		t = timeAt(pstore, mid);
+		if (t < time || (at && t == time))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return(lo);
+}
+
+long pvHistoryStoreQuery(pvHistoryStore *pstore, double t0, double t1,
+	long points, double *time, double **values, long n)
+{
+	long	nsamples, first, end, nrange, nbucket, b, i, i0, i1, imin, imax;
+	long	count = 0;
+	double	newest, v;
+	int		j;
+
+	if (points <= 0 || points > n) points = n;
+
+	epicsMutexMustLock(pstore->lock);
+	nsamples = pstore->count + pstore->nheld;
+	newest = nsamples ? timeAt(pstore, 0) : 0.0;
+	if (t1 <= 0.0) t1 += newest;
+	if (t0 <= 0.0) t0 += newest;
+
+	first = sampleSearch(pstore, nsamples, t1, 1);
+	end = sampleSearch(pstore, nsamples, t0, 0);
+	nrange = end - first;
+
+	if (nrange <= points) {
+		/* all of them */
+		for (i=first; i<end; i++, count++) {
+			time[count] = timeAt(pstore, i);
+			for (j=0; j<pstore->nchan; j++)
+				if (values[j]) values[j][count] = valueAt(pstore, j, i);
+		}
+	} else if (points >= 2) {
+		/* Two samples for each bucket, at its newest and oldest times.  For
+		 * each channel they hold the min and the max in the bucket, in the
+		 * order they came.
+		 */
+		nbucket = points/2;
+		for (b=0; b<nbucket; b++, count += 2) {
+			i0 = first + b*nrange/nbucket;
+			i1 = first + (b+1)*nrange/nbucket;
+			time[count] = timeAt(pstore, i0);
+			time[count+1] = timeAt(pstore, i1-1);
+			for (j=0; j<pstore->nchan; j++) {
+				if (values[j] == NULL) continue;
+				imin = imax = i0;
+				for (i=i0+1; i<i1; i++) {
+					v = valueAt(pstore, j, i);
+					if (v < valueAt(pstore, j, imin)) imin = i;
+					if (v > valueAt(pstore, j, imax)) imax = i;
+				}
+				values[j][count] = valueAt(pstore, j, MIN(imin, imax));
+				values[j][count+1] = valueAt(pstore, j, imin > imax ? imin : imax);
+			}
+		}
+	} else if (points == 1) {
+		/* no room for a range, just the newest sample in it */
+		time[0] = timeAt(pstore, first);
+		for (j=0; j<pstore->nchan; j++)
+			if (values[j]) values[j][0] = valueAt(pstore, j, first);
+		count = 1;
+	}
+
+	/* the rest as pvHistoryStoreCopy leaves it */
+	fillTime(pstore, time, count, n);
+	for (j=0; j<pstore->nchan; j++)
+		if (values[j]) memset(values[j] + count, 0, (n - count) * sizeof(double));
+	epicsMutexUnlock(pstore->lock);
+	return(count);
+}
+
+/* Accumulate the min, max, sum and sum of squares of n values, less shift
+ * so that the sums don't lose the variance of a large value.
+ */
+static void windowAdd(const double *x, long n, double shift, double *acc)
+{
+	double	mn = acc[0], mx = acc[1], s = acc[2], ss = acc[3], d;
+	long	i;
+
+	for (i=0; i<n; i++) {
+		mn = x[i] < mn ? x[i] : mn;
+		mx = x[i] > mx ? x[i] : mx;
+		d = x[i] - shift;
+		s += d;
+		ss += d*d;
+	}
+	acc[0] = mn; acc[1] = mx; acc[2] = s; acc[3] = ss;
+}
+
+/* the same for a column of floats */
+static void windowAddFloat(const float *x, long n, double shift, double *acc)
+{
+	double	mn = acc[0], mx = acc[1], s = acc[2], ss = acc[3], d;
+	long	i;
+
+	for (i=0; i<n; i++) {
+		mn = x[i] < mn ? x[i] : mn;
+		mx = x[i] > mx ? x[i] : mx;
+		d = x[i] - shift;
+		s += d;
+		ss += d*d;
+	}
+	acc[0] = mn; acc[1] = mx; acc[2] = s; acc[3] = ss;
+}
+
+long pvHistoryStoreWindow(pvHistoryStore *pstore, double span,
+	pvHistoryWindow *stats)
+{
+	const double *column;
+	const float *fcolumn;
+	double	acc[4], shift, var;
+	long	nsamples, end, count, first;
+	int		j, k;
+
+	epicsMutexMustLock(pstore->lock);
+	nsamples = pstore->count + pstore->nheld;
+	end = nsamples;
+	if (span > 0.0 && nsamples > 0)
+		end = sampleSearch(pstore, nsamples, timeAt(pstore, 0) - span, 0);
+
+	/* the ring part of the window, from head on, and then wrapped */
+	k = (pstore->nheld && end > 0) ? 1 : 0;
+	count = end - k;
+	first = MIN(count, pstore->size - pstore->head);
+
+	for (j=0; j<pstore->nchan; j++) {
+		memset(&stats[j], 0, sizeof(pvHistoryWindow));
+		if (end == 0) continue;
+		stats[j].count = end;
+
+		shift = valueAt(pstore, j, 0);
+		acc[0] = acc[1] = shift;
+		acc[2] = acc[3] = 0.0;
+		if (k) windowAdd(&pstore->held[j+1], 1, shift, acc);
+		if (pstore->single[j]) {
+			fcolumn = (const float *)pstore->column[j];
+			windowAddFloat(fcolumn + pstore->head, first, shift, acc);
+			windowAddFloat(fcolumn, count - first, shift, acc);
+		} else {
+			column = (const double *)pstore->column[j];
+			windowAdd(column + pstore->head, first, shift, acc);
+			windowAdd(column, count - first, shift, acc);
+		}
+
+		stats[j].min = acc[0];
+		stats[j].max = acc[1];
+		stats[j].mean = shift + acc[2]/end;
+		var = end > 1 ? (acc[3] - acc[2]*acc[2]/end)/(end - 1) : 0.0;
+		stats[j].sdev = var > 0.0 ? sqrt(var) : 0.0;
+	}
+	epicsMutexUnlock(pstore->lock);
+	return(end);
+}
+
+long pvHistoryStoreTierCopy(pvHistoryStore *pstore, int tier, int chan,
+	double *time, double **stats, long n)
+{
+	pvHistoryStoreTier *ptier;
+	double	*acc;
+	long	i, count, k;
+
+	if (tier < 0 || tier >= pstore->ntier || chan < 0 || chan >= pstore->nchan)
+		return(-1);
+	ptier = &pstore->tier[tier];
+	acc = ptier->acc + 3*chan;
+
+	epicsMutexMustLock(pstore->lock);
+	/* the bin being filled, if any, then the complete ones */
+	k = (ptier->nbin > 0 && n > 0) ? 1 : 0;
+	count = MIN(ptier->count, n - k);
+	if (k) {
+		if (time) time[0] = ptier->bin * ptier->interval;
+		if (stats[pvHistoryMin]) stats[pvHistoryMin][0] = acc[0];
+		if (stats[pvHistoryMax]) stats[pvHistoryMax][0] = acc[1];
+		if (stats[pvHistoryMean]) stats[pvHistoryMean][0] = acc[2] / ptier->nbin;
+		if (stats[pvHistoryCount]) stats[pvHistoryCount][0] = ptier->nbin;
+	}
+	if (time) {
+		copyColumn(ptier->time, ptier->head, ptier->size, time + k, count);
+		fillTime(pstore, time, count + k, n);
+	}
+	for (i=0; i<PVHISTORY_NSTATS; i++) {
+		if (stats[i] == NULL) continue;
+		copyColumn(tierColumn(ptier, chan, i), ptier->head, ptier->size,
+			stats[i] + k, count);
+		memset(stats[i] + count + k, 0, (n - count - k) * sizeof(double));
+	}
+	epicsMutexUnlock(pstore->lock);
+	return(count + k);
+}
+
+static void pvHistoryTierConfig(const char *name, double interval, int bins)
+{
+	tierConfig *pconfig;
+
+	if (name == NULL || *name == '\0') {
+		printf("pvHistoryTierConfig: a record name is needed\n");
+		return;
+	}
+	if (interval <= 0.0 || bins < 1) {
+		printf("pvHistoryTierConfig: interval and bins must be positive\n");
+		return;
+	}
+	if (pvHistoryStoreFind(name)) {
+		printf("pvHistoryTierConfig: %s already exists, tiers must be "
+			"configured before iocInit\n", name);
+		return;
+	}
+
+	pconfig = (tierConfig *)callocMustSucceed(1, sizeof(tierConfig),
+		"pvHistoryTierConfig");
+	pconfig->name = epicsStrDup(name);
+	pconfig->interval = interval;
+	pconfig->bins = bins;
+	ellAdd(&tierConfigList, &pconfig->node);
+}
+
+static void pvHistoryFileConfig(const char *name, const char *path,
+	double sync_period)
+{
+	fileConfig *pfile;
+
+	if (name == NULL || *name == '\0' || path == NULL || *path == '\0') {
+		printf("pvHistoryFileConfig: a record name and a file are needed\n");
+		return;
+	}
+	if (pvHistoryStoreFind(name)) {
+		printf("pvHistoryFileConfig: %s already exists, its file must be "
+			"configured before iocInit\n", name);
+		return;
+	}
+
+	pfile = (fileConfig *)callocMustSucceed(1, sizeof(fileConfig),
+		"pvHistoryFileConfig");
+	pfile->name = epicsStrDup(name);
+	pfile->path = epicsStrDup(path);
+	pfile->sync_period = sync_period;
+	ellAdd(&fileConfigList, &pfile->node);
+}
+
+static void pvHistoryCompressConfig(const char *name, int chan,
+	const char *mode, double tolerance)
+{
+	pvHistoryStore *pstore;
+	compressConfig *pconfig;
+	int		m;
+
+	if (name == NULL || *name == '\0' || mode == NULL) {
+		printf("pvHistoryCompressConfig: a record name and a mode are "
+			"needed\n");
+		return;
+	}
+	for (m=0; m<NELEMENTS(compressModeNames); m++)
+		if (!strcmp(mode, compressModeNames[m])) break;
+	if (m == NELEMENTS(compressModeNames)) {
+		printf("pvHistoryCompressConfig: mode must be none, deadband, "
+			"relative or swingingDoor\n");
+		return;
+	}
+	if (tolerance < 0.0) {
+		printf("pvHistoryCompressConfig: tolerance must not be negative\n");
+		return;
+	}
+
+	/* a running history changes its compression at once */
+	pstore = pvHistoryStoreFind(name);
+	if (pstore) {
+		epicsMutexMustLock(pstore->lock);
+		compressSet(pstore, chan, (pvHistoryCompressMode)m, tolerance);
+		compressFromNewest(pstore);
+		headerSave(pstore);
+		epicsMutexUnlock(pstore->lock);
+		return;
+	}
+
+	pconfig = (compressConfig *)callocMustSucceed(1, sizeof(compressConfig),
+		"pvHistoryCompressConfig");
+	pconfig->name = epicsStrDup(name);
+	pconfig->chan = chan;
+	pconfig->mode = (pvHistoryCompressMode)m;
+	pconfig->tolerance = tolerance;
+	ellAdd(&compressConfigList, &pconfig->node);
+}
+
+static void pvHistoryFloatConfig(const char *name, int chan)
+{
+	floatConfig *pconfig;
+
+	if (name == NULL || *name == '\0') {
+		printf("pvHistoryFloatConfig: a record name is needed\n");
+		return;
+	}
+	if (pvHistoryStoreFind(name)) {
+		printf("pvHistoryFloatConfig: %s already exists, float channels "
+			"must be configured before iocInit\n", name);
+		return;
+	}
+
+	pconfig = (floatConfig *)callocMustSucceed(1, sizeof(floatConfig),
+		"pvHistoryFloatConfig");
+	pconfig->name = epicsStrDup(name);
+	pconfig->chan = chan;
+	ellAdd(&floatConfigList, &pconfig->node);
+}
+
+static void pvHistoryQuery(const char *name, double t0, double t1,
+	int points)
+{
+	pvHistoryStore *pstore;
+	double	*buf, **values;
+	long	i, count;
+	int		j;
+
+	pstore = name ? pvHistoryStoreFind(name) : NULL;
+	if (pstore == NULL) {
+		printf("pvHistoryQuery: no history %s\n", name ? name : "");
+		return;
+	}
+	if (points <= 0) points = 20;
+
+	buf = (double *)callocMustSucceed((pstore->nchan+1)*points, sizeof(double),
+		"pvHistoryQuery");
+	values = (double **)callocMustSucceed(pstore->nchan, sizeof(double *),
+		"pvHistoryQuery");
+	for (j=0; j<pstore->nchan; j++) values[j] = buf + (j+1)*points;
+
+	count = pvHistoryStoreQuery(pstore, t0, t1, points, buf, values, points);
+	for (i=0; i<count; i++) {
+		printf("%.3f", buf[i]);
+		for (j=0; j<pstore->nchan; j++) printf(" %g", values[j][i]);
+		printf("\n");
+	}
+	printf("%ld samples\n", count);
+	free(values);
+	free(buf);
+}
+
+static void pvHistoryReport(int level)
+{
+	pvHistoryStore *pstore;
+	pvHistoryStoreTier *ptier;
+	int		i;
+
+	if (ellCount(&storeList) == 0) {
+		printf("pvHistoryReport: no histories\n");
+		return;
+	}
+
+	for (pstore = (pvHistoryStore *)ellFirst(&storeList); pstore;
+		pstore = (pvHistoryStore *)ellNext(&pstore->node)) {
+		epicsMutexMustLock(pstore->lock);
+		printf("%s: %d channels, %ld of %ld samples, %d tiers\n",
+			pstore->name, pstore->nchan, pstore->count, pstore->size,
+			pstore->ntier);
+		if (level > 0) {
+			printf("  %lu bytes%s\n", (unsigned long)pstore->bytes,
+				pstore->mapped ? ", kept in a file" : "");
+			if (pstore->count)
+				printf("  times to %g seconds\n", pstore->time_unit);
+			for (i=0; i<pstore->nchan; i++) {
+				if (pstore->single[i]) printf("  channel %d: float\n", i);
+				if (pstore->compress[i].mode == pvHistoryCompressNone)
+					continue;
+				printf("  channel %d: %s %g\n", i,
+					compressModeNames[pstore->compress[i].mode],
+					pstore->compress[i].tolerance);
+			}
+			printf("  %lu samples offered since the IOC started\n",
+				pstore->offered);
+			for (i=0; i<pstore->ntier; i++) {
+				ptier = &pstore->tier[i];
+				printf("  tier %d: %g seconds per bin, %ld of %ld bins\n", i,
+					ptier->interval, ptier->count, ptier->size);
+			}
+		}
+		epicsMutexUnlock(pstore->lock);
+	}
+}
+
+static const iocshArg tierConfigArg0 = { "name", iocshArgString };
+static const iocshArg tierConfigArg1 = { "interval", iocshArgDouble };
+static const iocshArg tierConfigArg2 = { "bins", iocshArgInt };
+static const iocshArg * const tierConfigArgs[3] = {
+	&tierConfigArg0, &tierConfigArg1, &tierConfigArg2 };
+static const iocshFuncDef tierConfigFuncDef = { "pvHistoryTierConfig", 3,
+	tierConfigArgs };
+static void tierConfigCallFunc(const iocshArgBuf *args)
+{
+	pvHistoryTierConfig(args[0].sval, args[1].dval, args[2].ival);
+}
+
+static const iocshArg fileConfigArg0 = { "name", iocshArgString };
+static const iocshArg fileConfigArg1 = { "path", iocshArgString };
+static const iocshArg fileConfigArg2 = { "sync period", iocshArgDouble };
+static const iocshArg * const fileConfigArgs[3] = {
+	&fileConfigArg0, &fileConfigArg1, &fileConfigArg2 };
+static const iocshFuncDef fileConfigFuncDef = { "pvHistoryFileConfig", 3,
+	fileConfigArgs };
+static void fileConfigCallFunc(const iocshArgBuf *args)
+{
+	pvHistoryFileConfig(args[0].sval, args[1].sval, args[2].dval);
+}
+
+static const iocshArg compressConfigArg0 = { "name", iocshArgString };
+static const iocshArg compressConfigArg1 = { "channel", iocshArgInt };
+static const iocshArg compressConfigArg2 = { "mode", iocshArgString };
+static const iocshArg compressConfigArg3 = { "tolerance", iocshArgDouble };
+static const iocshArg * const compressConfigArgs[4] = {
+	&compressConfigArg0, &compressConfigArg1, &compressConfigArg2,
+	&compressConfigArg3 };
+static const iocshFuncDef compressConfigFuncDef = { "pvHistoryCompressConfig",
+	4, compressConfigArgs };
+static void compressConfigCallFunc(const iocshArgBuf *args)
+{
+	pvHistoryCompressConfig(args[0].sval, args[1].ival, args[2].sval,
+		args[3].dval);
+}
+
+static const iocshArg floatConfigArg0 = { "name", iocshArgString };
+static const iocshArg floatConfigArg1 = { "channel", iocshArgInt };
+static const iocshArg * const floatConfigArgs[2] = {
+	&floatConfigArg0, &floatConfigArg1 };
+static const iocshFuncDef floatConfigFuncDef = { "pvHistoryFloatConfig", 2,
+	floatConfigArgs };
+static void floatConfigCallFunc(const iocshArgBuf *args)
+{
+	pvHistoryFloatConfig(args[0].sval, args[1].ival);
+}
+
+static const iocshArg queryArg0 = { "name", iocshArgString };
+static const iocshArg queryArg1 = { "t0", iocshArgDouble };
+static const iocshArg queryArg2 = { "t1", iocshArgDouble };
+static const iocshArg queryArg3 = { "points", iocshArgInt };
+static const iocshArg * const queryArgs[4] = {
+	&queryArg0, &queryArg1, &queryArg2, &queryArg3 };
+static const iocshFuncDef queryFuncDef = { "pvHistoryQuery", 4, queryArgs };
+static void queryCallFunc(const iocshArgBuf *args)
+{
+	pvHistoryQuery(args[0].sval, args[1].dval, args[2].dval, args[3].ival);
+}
+
+static const iocshArg reportArg0 = { "level", iocshArgInt };
+static const iocshArg * const reportArgs[1] = { &reportArg0 };
+static const iocshFuncDef reportFuncDef = { "pvHistoryReport", 1,
+	reportArgs };
+static void reportCallFunc(const iocshArgBuf *args)
+{
+	pvHistoryReport(args[0].ival);
+}
+
+static void pvHistoryStoreRegister(void)
+{
+	iocshRegister(&tierConfigFuncDef, tierConfigCallFunc);
+	iocshRegister(&fileConfigFuncDef, fileConfigCallFunc);
+	iocshRegister(&compressConfigFuncDef, compressConfigCallFunc);
+	iocshRegister(&floatConfigFuncDef, floatConfigCallFunc);
+	iocshRegister(&queryFuncDef, queryCallFunc);
+	iocshRegister(&reportFuncDef, reportCallFunc);
+}
+epicsExportRegistrar(pvHistoryStoreRegister);
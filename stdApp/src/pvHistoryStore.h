@@ -0,0 +1,196 @@
+/* pvHistoryStore.h - Sample history of a group of PVs sharing a time axis */
+/*
+ * A store keeps the last size samples of nchan channels.  The samples are
+ * kept in one block, as a time column followed by one column per channel,
+ * each column being a ring filled from the top down.  Adding a sample
+ * costs the same however long the history is; the history is copied out,
+ * newest sample first, only when somebody wants to see it.
+ *
+ * To fit more samples in the memory of a small IOC, the time column holds
+ * 32-bit offsets from a base time, at a resolution of a millisecond or,
+ * for a history longer than 49 days, as fine as 32 bits allow.  Channels
+ * configured with pvHistoryFloatConfig before iocInit are kept as floats.
+ * The times and values are converted back to doubles when copied out.  The
+ * arrays they're copied into are the caller's: the outputs of a pvHistory
+ * aSub record hold the whole history as doubles, while a history record
+ * copies one array at a time, as it's read.
+ *
+ * A store can also have tiers, configured with pvHistoryTierConfig before
+ * iocInit.  A tier consolidates the samples into bins of a fixed interval,
+ * keeping the min, max, mean and count of each channel in each bin, so a
+ * long history at a coarse resolution can be kept next to a short one at
+ * full resolution.  The bins are consolidated as the samples arrive.
+ *
+ * All of a store is in one block of memory, which can be a memory-mapped
+ * file configured with pvHistoryFileConfig before iocInit.  The history is
+ * then written in place, and when the IOC restarts the store re-attaches
+ * to the history in the file.
+ *
+ * The channels can be compressed, with a deadband or a swinging door, so
+ * that only the samples needed to follow the signal within a tolerance are
+ * stored.  Since the channels share the time axis, a sample is stored when
+ * any channel needs it, and a channel that isn't compressed needs them all.
+ *
+ * Modification Log:
+ * -----------------
+ * 10/19/26  AG  First version, from the ring buffer in pvHistory.c.
+ * 10/19/26  AG  Consolidated tiers, stores are found by name.
+ * 10/19/26  AG  Stores can be kept in a memory-mapped file.
+ * 10/19/26  AG  Deadband and swinging door compression.
+ * 10/19/26  AG  Time range queries.
+ * 10/19/26  AG  Window statistics.
+ * 10/19/26  AG  32-bit time offsets, and float channels.
+ */
+
+#ifndef INC_pvHistoryStore_H
+#define INC_pvHistoryStore_H
+
+#include <ellLib.h>
+#include <epicsMutex.h>
+#include <epicsTypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the columns a tier keeps for each channel */
+typedef enum {
+	pvHistoryMin, pvHistoryMax, pvHistoryMean, pvHistoryCount
+} pvHistoryStat;
+#define PVHISTORY_NSTATS 4
+
+typedef enum {
+	pvHistoryCompressNone,
+	pvHistoryCompressDeadband,		/* store when a value moves by tolerance */
+	pvHistoryCompressRelative,		/* ... by tolerance times the value */
+	pvHistoryCompressSwingingDoor	/* store to stay within tolerance of a line */
+} pvHistoryCompressMode;
+
+typedef struct pvHistoryCompress {
+	pvHistoryCompressMode mode;
+	double	tolerance;
+	double	ref;			/* value of the last stored sample */
+	double	ref_time;		/* and its time */
+	double	upper;			/* slopes of the swinging door */
+	double	lower;
+} pvHistoryCompress;
+
+/* statistics of one channel over a window of the history */
+typedef struct pvHistoryWindow {
+	long	count;			/* samples in the window */
+	double	min;
+	double	max;
+	double	mean;
+	double	sdev;			/* sample standard deviation, over n-1 */
+} pvHistoryWindow;
+
+typedef struct pvHistoryStoreTier {
+	double	interval;		/* seconds per bin */
+	long	size;			/* bins the tier can hold */
+	long	head;			/* index of the newest complete bin */
+	long	count;			/* complete bins in the tier */
+	double	*time;			/* start time of each bin */
+	double	*stats;			/* PVHISTORY_NSTATS columns per channel */
+
+	/* the bin being filled */
+	double	bin;			/* its number, time/interval */
+	long	nbin;			/* samples in it */
+	double	*acc;			/* min, max and sum for each channel */
+} pvHistoryStoreTier;
+
+typedef struct pvHistoryStore {
+	ELLNODE	node;			/* entry in the list of stores */
+	char	*name;
+	epicsMutexId lock;
+	int		nchan;			/* number of value columns */
+	long	size;			/* samples each column can hold */
+	long	head;			/* index of the newest sample */
+	long	count;			/* samples in the store */
+	double	fill_time;		/* time of unused elements after a clear */
+	double	time_base;		/* seconds past epoch of time offset 0 */
+	double	time_unit;		/* seconds per step of the time offsets */
+	epicsUInt32 *time;		/* time column, offsets from time_base */
+	void	**column;		/* value column of each channel */
+	int		*single;		/* 1 for a column of floats, 0 of doubles */
+
+	int		ntier;
+	pvHistoryStoreTier *tier;
+
+	pvHistoryCompress *compress;	/* one per channel */
+	double	*held;			/* time and values of the sample held back */
+	int		nheld;			/* 1 if a sample is held back */
+	unsigned long offered;	/* samples added, stored or not */
+
+	void	*block;			/* header, ring state and columns */
+	size_t	bytes;			/* size of the block */
+	int		mapped;			/* the block is a memory-mapped file */
+	double	sync_period;	/* seconds between msync()s, 0 to leave it to the OS */
+	double	sync_time;		/* sample time of the last msync() */
+} pvHistoryStore;
+
+/* Create a store, with the tiers and file configured for its name.  A store
+ * kept in a file may already hold samples.
+ */
+pvHistoryStore *pvHistoryStoreCreate(const char *name, int nchan, long size);
+
+/* Returns the store of that name, or NULL */
+pvHistoryStore *pvHistoryStoreFind(const char *name);
+
+/* Forget all samples.  Unused elements get the time of the clear. */
+void pvHistoryStoreClear(pvHistoryStore *pstore, double time);
+
+/* Add a sample: the time and one value for each channel */
+void pvHistoryStoreAdd(pvHistoryStore *pstore, double time,
+	const double *values);
+
+/* Copy the history into time and the value arrays (NULL to skip a column),
+ * newest sample first, starting with a sample held back by the compression.
+ * The arrays are filled to n elements, elements past the last sample
+ * getting the value 0 and the time of the oldest sample.
+ * Returns the number of samples copied.
+ */
+long pvHistoryStoreCopy(pvHistoryStore *pstore, double *time,
+	double **values, long n);
+
+/* Replace the history with the samples in n elements of arrays left by
+ * pvHistoryStoreCopy, newest first.  The fill after the last sample is
+ * skipped, and the tiers are rebuilt from the samples.
+ */
+void pvHistoryStoreLoad(pvHistoryStore *pstore, const double *time,
+	const double **values, long n);
+
+/* Copy the samples from time t0 to t1 into time and the value arrays (NULL
+ * to skip a column), newest sample first.  A time of 0 or less is relative
+ * to the newest sample.  If there are more than points samples in the
+ * range, the range is split into points/2 buckets, each giving two samples
+ * that hold the min and max of each channel in the bucket.  The arrays are
+ * filled to n elements as by pvHistoryStoreCopy.  Returns the number of
+ * samples copied.
+ */
+long pvHistoryStoreQuery(pvHistoryStore *pstore, double t0, double t1,
+	long points, double *time, double **values, long n);
+
+/* Copy the bins of one tier for one channel into time and stats[] (indexed
+ * by pvHistoryStat, NULL to skip a column), newest bin first.  The bin
+ * being filled comes first.  The arrays are filled to n elements as by
+ * pvHistoryStoreCopy.  Returns the number of bins copied, or -1 if there is
+ * no such tier or channel.
+ */
+long pvHistoryStoreTierCopy(pvHistoryStore *pstore, int tier, int chan,
+	double *time, double **stats, long n);
+
+/* The statistics of each channel, into stats[nchan], over the samples no
+ * more than span seconds older than the newest, or over all samples if
+ * span is 0 or less.  A sample held back by the compression is included.
+ * The standard deviation is the sample one, dividing by n-1, and is 0 for
+ * a single sample.  The statistics are 0 if there are no samples.  Returns
+ * the number of samples in the window.
+ */
+long pvHistoryStoreWindow(pvHistoryStore *pstore, double span,
+	pvHistoryWindow *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_pvHistoryStore_H */
@@ -0,0 +1,25 @@
+/* stdCompat.c */
+
+/* stdCompat.c - Compatibility with the versions of EPICS base std builds with */
+/*
+ * Modification Log:
+ * -----------------
+ * 10/19/26  AG  First version, from the copies in the epid and throttle
+ *               sources.
+ */
+
+#include <epicsTime.h>
+
+#include "stdCompat.h"
+
+double stdMonotonicSeconds(void)
+{
+#if LT_EPICSBASE(3,16,1,0)
+    epicsTimeStamp now;
+
+    epicsTimeGetCurrent(&now);
+    return(now.secPastEpoch + now.nsec/1.e9);
+#else
+    return(epicsMonotonicGet()/1.e9);
+#endif
+}
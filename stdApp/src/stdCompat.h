@@ -0,0 +1,39 @@
+/* stdCompat.h */
+
+/* stdCompat.h - Compatibility with the versions of EPICS base std builds with */
+/*
+ * LT_EPICSBASE(V,R,M,P) is true when building with a base older than
+ * V.R.M.P.
+ *
+ * stdMonotonicSeconds() returns seconds from the monotonic clock, for
+ * intervals that must not jump when the wall clock is corrected.  Before
+ * base 3.16.1 there is no monotonic clock, and the wall clock is used.
+ *
+ * Modification Log:
+ * -----------------
+ * 10/19/26  AG  First version, from the copies in the epid and throttle
+ *               sources.
+ */
+
+#ifndef INC_stdCompat_H
+#define INC_stdCompat_H
+
+#include <epicsVersion.h>
+
+#ifndef EPICS_VERSION_INT
+#define VERSION_INT(V,R,M,P) ( ((V)<<24) | ((R)<<16) | ((M)<<8) | (P))
+#define EPICS_VERSION_INT VERSION_INT(EPICS_VERSION, EPICS_REVISION, EPICS_MODIFICATION, EPICS_PATCH_LEVEL)
+#endif
+#define LT_EPICSBASE(V,R,M,P) (EPICS_VERSION_INT < VERSION_INT((V),(R),(M),(P)))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+double stdMonotonicSeconds(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_stdCompat_H */
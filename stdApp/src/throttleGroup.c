@@ -0,0 +1,313 @@
+/* throttleGroup.c */
+
+/***************************************************
+
+throttleGroup.c -
+Put budget shared by a group of throttle records
+
+When several throttle records feed the same slow device, each record
+throttling itself still lets N records send N times the rate the device
+can take.  The records of a group share one rate: a value may be sent
+when at least 1/RATE seconds have passed since the group last sent one,
+and otherwise the record waits its turn in a queue.  A record is only in
+the queue once, and sends whatever its value is when its turn comes.
+
+iocsh commands:
+  throttleGroupConfig(name, rate)   create a group, before iocInit
+  throttleGroupReport(level)        show the groups
+
+Modification Log:
+----------------
+10/19/2026 AG   First version.
+
+*****************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <epicsMutex.h>
+#include <epicsString.h>
+#include <epicsTime.h>
+#include <cantProceed.h>
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include "throttleGroup.h"
+
+
+#include "stdCompat.h"
+
+
+struct throttleGroup
+{
+  ELLNODE node;       /* entry in groupList */
+  char *name;
+  double rate;        /* values per second for the whole group, 0 for no limit */
+  double last_time;   /* monotonic time the group last sent a value */
+
+  ELLLIST queue;      /* members waiting for their turn */
+  CALLBACK turnCb;
+  int turn_pending;   /* turnCb is scheduled, or a member has the turn */
+  throttleGroupMember *pturn;  /* member that has the turn */
+  epicsMutexId lock;
+
+  /* statistics, for throttleGroupReport */
+  int members;
+  unsigned long sent;
+  unsigned long queued;
+  unsigned long skipped;
+  int queue_max;
+};
+
+static ELLLIST groupList = ELLLIST_INIT;
+
+
+
+static throttleGroup *findGroup( const char *name)
+{
+  throttleGroup *pgroup;
+
+  for( pgroup = (throttleGroup *) ellFirst(&groupList); pgroup != NULL;
+       pgroup = (throttleGroup *) ellNext(&pgroup->node))
+    if( !strcmp( pgroup->name, name))
+      return pgroup;
+
+  return NULL;
+}
+
+
+/* Give the member at the head of the queue its turn.  The next turn is
+   scheduled when the member reports back, see throttleGroupTurnDone(). */
+static void turnCallback( CALLBACK *pcallback)
+{
+  throttleGroup *pgroup;
+  throttleGroupMember *pmember;
+
+  callbackGetUser(pgroup, pcallback);
+
+  epicsMutexMustLock(pgroup->lock);
+
+  // if the limit was taken off, everybody waiting gets a turn now
+  if( pgroup->rate <= 0.0)
+    {
+      while( (pmember = (throttleGroupMember *) ellGet(&pgroup->queue)) )
+        {
+          pmember->queued = 0;
+          callbackRequest( pmember->pcallback);
+        }
+      pgroup->turn_pending = 0;
+      epicsMutexUnlock(pgroup->lock);
+      return;
+    }
+
+  pmember = (throttleGroupMember *) ellGet(&pgroup->queue);
+  if( pmember == NULL)
+    pgroup->turn_pending = 0;
+  else
+    {
+      pmember->queued = 0;
+      pgroup->pturn = pmember;
+      callbackRequest( pmember->pcallback);
+    }
+
+  epicsMutexUnlock(pgroup->lock);
+}
+
+
+void throttleGroupTurnDone( throttleGroupMember *pmember, int sent)
+{
+  throttleGroup *pgroup = pmember->pgroup;
+
+  if( pgroup == NULL)
+    return;
+
+  epicsMutexMustLock(pgroup->lock);
+
+  if( sent)
+    {
+      pgroup->last_time = stdMonotonicSeconds();
+      pgroup->sent++;
+    }
+  else
+    pgroup->skipped++;
+
+  // a turn given when the limit was taken off isn't tracked
+  if( pgroup->pturn == pmember)
+    {
+      pgroup->pturn = NULL;
+      if( ellCount(&pgroup->queue) == 0)
+        pgroup->turn_pending = 0;
+      else if( sent && (pgroup->rate > 0.0) )
+        callbackRequestDelayed(&pgroup->turnCb, 1.0 / pgroup->rate);
+      else
+        callbackRequest(&pgroup->turnCb);
+    }
+
+  epicsMutexUnlock(pgroup->lock);
+}
+
+
+int throttleGroupJoin( throttleGroupMember *pmember, const char *name,
+                       CALLBACK *pcallback)
+{
+  throttleGroup *pgroup;
+
+  pmember->pgroup = NULL;
+  pmember->pcallback = pcallback;
+  pmember->queued = 0;
+
+  pgroup = findGroup( name);
+  if( pgroup == NULL)
+    return -1;
+
+  epicsMutexMustLock(pgroup->lock);
+  pgroup->members++;
+  epicsMutexUnlock(pgroup->lock);
+
+  pmember->pgroup = pgroup;
+  return 0;
+}
+
+
+int throttleGroupRequest( throttleGroupMember *pmember)
+{
+  throttleGroup *pgroup = pmember->pgroup;
+  double now;
+  double wait;
+
+  if( pgroup == NULL)
+    return 1;
+
+  epicsMutexMustLock(pgroup->lock);
+
+  if( pgroup->rate <= 0.0)
+    {
+      epicsMutexUnlock(pgroup->lock);
+      return 1;
+    }
+
+  if( pmember->queued)
+    {
+      // it will send its latest value when its turn comes
+      epicsMutexUnlock(pgroup->lock);
+      return 0;
+    }
+
+  now = stdMonotonicSeconds();
+  wait = pgroup->last_time + 1.0 / pgroup->rate - now;
+
+  // nobody is waiting or has the turn, and the group has spare budget
+  if( (ellCount(&pgroup->queue) == 0) && (pgroup->pturn == NULL) &&
+      (wait <= 0.0) )
+    {
+      pgroup->last_time = now;
+      pgroup->sent++;
+      epicsMutexUnlock(pgroup->lock);
+      return 1;
+    }
+
+  pmember->queued = 1;
+  ellAdd(&pgroup->queue, &pmember->node);
+  pgroup->queued++;
+  if( ellCount(&pgroup->queue) > pgroup->queue_max)
+    pgroup->queue_max = ellCount(&pgroup->queue);
+
+  if( !pgroup->turn_pending)
+    {
+      pgroup->turn_pending = 1;
+      callbackRequestDelayed(&pgroup->turnCb, (wait > 0.0) ? wait : 0.0);
+    }
+
+  epicsMutexUnlock(pgroup->lock);
+  return 0;
+}
+
+
+static void throttleGroupConfig( const char *name, double rate)
+{
+  throttleGroup *pgroup;
+
+  if( (name == NULL) || (*name == '\0') )
+    {
+      printf("throttleGroupConfig: a group name is needed\n");
+      return;
+    }
+
+  pgroup = findGroup( name);
+  if( pgroup != NULL)
+    {
+      // changing the rate of a group is allowed at any time
+      epicsMutexMustLock(pgroup->lock);
+      pgroup->rate = rate;
+      epicsMutexUnlock(pgroup->lock);
+      return;
+    }
+
+  pgroup = callocMustSucceed(1, sizeof(throttleGroup), "throttleGroupConfig");
+  pgroup->name = epicsStrDup( name);
+  pgroup->rate = rate;
+  pgroup->lock = epicsMutexMustCreate();
+  ellInit(&pgroup->queue);
+
+  callbackSetCallback(turnCallback, &pgroup->turnCb);
+  callbackSetPriority(priorityMedium, &pgroup->turnCb);
+  callbackSetUser(pgroup, &pgroup->turnCb);
+
+  ellAdd(&groupList, &pgroup->node);
+}
+
+
+static void throttleGroupReport( int level)
+{
+  throttleGroup *pgroup;
+
+  if( ellCount(&groupList) == 0)
+    {
+      printf("throttleGroupReport: no throttle groups are configured\n");
+      return;
+    }
+
+  for( pgroup = (throttleGroup *) ellFirst(&groupList); pgroup != NULL;
+       pgroup = (throttleGroup *) ellNext(&pgroup->node))
+    {
+      epicsMutexMustLock(pgroup->lock);
+
+      printf("throttle group %s: rate %g, %d members, %d waiting\n",
+             pgroup->name, pgroup->rate, pgroup->members,
+             ellCount(&pgroup->queue));
+      if( level > 0)
+        printf("  sent %lu, queued %lu, turns skipped %lu, longest queue %d\n",
+               pgroup->sent, pgroup->queued, pgroup->skipped,
+               pgroup->queue_max);
+
+      epicsMutexUnlock(pgroup->lock);
+    }
+}
+
+
+static const iocshArg configArg0 = { "name", iocshArgString };
+static const iocshArg configArg1 = { "rate", iocshArgDouble };
+static const iocshArg * const configArgs[2] = { &configArg0, &configArg1 };
+static const iocshFuncDef configFuncDef = { "throttleGroupConfig", 2,
+                                            configArgs };
+static void configCallFunc( const iocshArgBuf *args)
+{
+  throttleGroupConfig( args[0].sval, args[1].dval);
+}
+
+static const iocshArg reportArg0 = { "level", iocshArgInt };
+static const iocshArg * const reportArgs[1] = { &reportArg0 };
+static const iocshFuncDef reportFuncDef = { "throttleGroupReport", 1,
+                                            reportArgs };
+static void reportCallFunc( const iocshArgBuf *args)
+{
+  throttleGroupReport( args[0].ival);
+}
+
+static void throttleGroupRegister(void)
+{
+  iocshRegister(&configFuncDef, configCallFunc);
+  iocshRegister(&reportFuncDef, reportCallFunc);
+}
+epicsExportRegistrar(throttleGroupRegister);
@@ -0,0 +1,60 @@
+/* throttleGroup.h */
+
+/***************************************************
+
+throttleGroup.h -
+Put budget shared by a group of throttle records
+
+Throttle records that name the same group in GRP share one aggregate
+rate.  A record that is ready to send asks its group, and either may
+send at once or is queued.  Queued records are served in round-robin
+order, each sending its latest value when its turn comes.  A member that
+can't use its turn, because it is waiting for its own pacing or for a put
+to complete, hands it straight on to the next member.  Groups are
+created with the throttleGroupConfig iocsh command before iocInit.
+
+Modification Log:
+----------------
+10/19/2026 AG   First version.
+
+*****************************************************/
+
+#ifndef INC_throttleGroup_H
+#define INC_throttleGroup_H
+
+#include <ellLib.h>
+#include <callback.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct throttleGroup throttleGroup;
+
+typedef struct throttleGroupMember
+{
+  ELLNODE node;         /* entry in the group's queue */
+  throttleGroup *pgroup;
+  CALLBACK *pcallback;  /* requested when it is the member's turn */
+  int queued;
+} throttleGroupMember;
+
+/* Join the named group.  Returns 0, or -1 if no such group is configured. */
+int throttleGroupJoin( throttleGroupMember *pmember, const char *name,
+                       CALLBACK *pcallback);
+
+/* Ask to send a value.  Returns 1 if the member may send now; otherwise
+   the member is queued (once, however often it asks) and its callback is
+   requested when its turn comes. */
+int throttleGroupRequest( throttleGroupMember *pmember);
+
+/* Called by a member when it has handled its turn, with sent 1 if it sent
+   a value.  Otherwise the turn goes to the next member at once, and the
+   member asks again when it is ready. */
+void throttleGroupTurnDone( throttleGroupMember *pmember, int sent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_throttleGroup_H */
@@ -12,6 +12,37 @@ Modification Log:
 04/21/2016 DAA  0-2-0  First release as part of std module
                        I had a seperate module locally as I worked on it.
 04/22/2016 DAA  0-2-1  Added back the sync functionality.
+10/19/2026 AG   0-3-0  Added the token bucket mode (MODE, RATE, BRST), where
+                       idle time earns credit for bursts of up to BRST values.
+10/19/2026 AG   0-3-1  Added OMOD, so a CA output link can be written with a
+                       put callback.  WAIT stays True until the put completes,
+                       and the next value isn't sent until both the put has
+                       completed and the delay has passed.  The put fails if
+                       OUT disconnects or is INVALID when it completes.
+10/19/2026 AG   0-3-2  CA link connections are tracked with connection
+                       callbacks, rather than by polling until they connect
+                       and checking the OUT link on every put.  The link
+                       options are kept when the channel is replaced.
+10/19/2026 AG   0-3-3  The delays can use a timer wheel shared by all throttle
+                       records, see throttleTimer.c.
+10/19/2026 AG   0-3-4  Added GRP, to share a rate with the other records of a
+                       throttle group, see throttleGroup.c.  A record that
+                       can't use its turn hands it on to the next.
+10/19/2026 AG   0-3-5  Added counters of the values coalesced, sent and
+                       rejected, and the wait time statistics (NCOA, NSNT,
+                       NREJ, WAVG, WMAX, WHST), reset by writing 1 to CRST.
+10/19/2026 AG   0-3-6  Added the ramp mode, where each delay moves the output
+                       at most STEP toward VAL.
+10/19/2026 AG   0-3-7  Added arrays: with NELM > 1 the value is the AVAL
+                       array, copied into ASNT when it is sent.  Both are
+                       allocated once, at init.
+10/19/2026 AG   0-3-8  SYNC is done from a callback task instead of in the
+                       put to SYNC, and waits for a value from a CA SINP.
+                       The SYNC fails, with STS set to Error, if SINP
+                       disconnects or no value comes within 5 seconds.
+10/19/2026 AG   0-3-9  Added the monitor mode, which republishes INP at a
+                       limited rate: VAL and SENT are only posted when a
+                       value is sent, and OUT is optional.
 
 *****************************************************/
 
@@ -34,21 +65,25 @@ Modification Log:
 #include <recSup.h>
 #include <special.h>
 #include <callback.h>
+#include <dbCa.h>
+#include <epicsTime.h>
+#include <errlog.h>
+#include <cantProceed.h>
 #define GEN_SIZE_OFFSET
 #include "throttleRecord.h"
 #undef  GEN_SIZE_OFFSET
+#include "throttleTimer.h"
+#include "throttleGroup.h"
 #include "epicsExport.h"
 
 
-#include <epicsVersion.h>
-#ifndef EPICS_VERSION_INT
-#define VERSION_INT(V,R,M,P) ( ((V)<<24) | ((R)<<16) | ((M)<<8) | (P))
-#define EPICS_VERSION_INT VERSION_INT(EPICS_VERSION, EPICS_REVISION, EPICS_MODIFICATION, EPICS_PATCH_LEVEL)
-#endif
-#define LT_EPICSBASE(V,R,M,P) (EPICS_VERSION_INT < VERSION_INT((V),(R),(M),(P)))
+#include "stdCompat.h"
+
 
+#define VERSION "0-3-9"
 
-#define VERSION "0-2-1"
+// how long a SYNC waits for a CA SINP to deliver a value, in seconds
+#define SYNC_TIMEOUT 5.0
 
 
 /* Create RSET - Record Support Entry Table */
@@ -58,9 +93,9 @@ static long init_record();
 static long process();
 static long special();
 #define get_value NULL
-#define cvt_dbaddr NULL
-#define get_array_info NULL
-#define put_array_info NULL
+static long cvt_dbaddr();
+static long get_array_info();
+static long put_array_info();
 #define get_units NULL
 static long get_precision();
 #define get_enum_str NULL
@@ -100,10 +135,41 @@ static void checkAlarms(throttleRecord *prec);
 static void enterValue( throttleRecord *prec);
 static void delayFuncCallback();
 static void valuePut( throttleRecord *prec);
+static void valuePutDone( throttleRecord *prec, long status);
+static void monitor( throttleRecord *prec);
+static void putCallback( void *userPvt);
+static void groupCallback( CALLBACK *pcallback);
 static void valueSync( throttleRecord *prec);
+static void syncCallback( CALLBACK *pcallback);
+static void syncTimeoutCallback( CALLBACK *pcallback);
+static void syncFail( throttleRecord *prec);
+static void sinpMonitorCallback( void *userPvt);
 
 static void checkLinkCallback();
 static void checkLink();
+static void linkConnectCallback( void *userPvt);
+static void addLinkCallback( throttleRecord *prec, struct link *plink,
+                             dbCaCallback monitor);
+
+static void refillTokens( throttleRecord *prec);
+static double tokenRate( throttleRecord *prec);
+static double nextDelay( throttleRecord *prec);
+static int spendToken( throttleRecord *prec);
+static void restartDelay( throttleRecord *prec);
+static void delayStart( throttleRecord *prec, double delay);
+static void delayCancel( throttleRecord *prec);
+static void waitStatistics( throttleRecord *prec);
+static double rampValue( throttleRecord *prec);
+static int readInput( throttleRecord *prec);
+static void resetStatistics( throttleRecord *prec);
+
+/* Upper edges of the wait time histogram bins, in seconds.  The last bin
+   holds everything longer. */
+static const double waitBinEdges[THROTTLE_NUM_WAIT_BINS - 1] =
+  {
+    0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5,
+    1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0
+  };
 
 enum { NOT_CA_LINK, CA_LINK_OK, CA_LINK_NOT_OK };
 typedef struct rpvtStruct 
@@ -114,13 +180,34 @@ typedef struct rpvtStruct
 
   int delay_flag;
   int sync_flag;
+  int sync_pending;     /* a SYNC is queued or waiting for a SINP value */
+  int sync_value_wait;  /* waiting for the first SINP value */
+  CALLBACK syncCb;
+  CALLBACK syncTimeoutCb;
   int wait_flag;
+  int put_flag;    /* a put callback is outstanding */
+  int sent_flag;   /* SENT holds a value that was sent */
+  long nsend;      /* elements being sent */
+  epicsTimeStamp inp_time;  /* time stamp of the INP value, in monitor mode */
 
   int limit_flag;
   double limit_high;
   double limit_low;
 
+  double tokens;      /* token bucket credit */
+  double token_time;  /* monotonic time tokens was last updated */
+
   CALLBACK delayFuncCb;
+  int use_wheel;             /* delayTimer is used instead of the timer queue */
+  throttleTimer delayTimer;
+
+  double wait_start;   /* monotonic time the pending value started waiting */
+  double wait_sum;
+  unsigned long wait_n;
+
+  CALLBACK groupCb;
+  throttleGroupMember groupMember;
+  int group_turn;            /* the group has given this record its turn */
 
   CALLBACK checkLinkCb;
   short    pending_checkLinkCB;
@@ -149,6 +236,20 @@ static long init_record(void *precord,int pass)
       strcpy(prec->ver, VERSION);
       prec->rpvt = calloc(1, sizeof(struct rpvtStruct));
 
+      // the pending array and the one being sent
+      if( prec->nelm < 1)
+        prec->nelm = 1;
+      if( prec->nelm > 1)
+        {
+          prec->aval = callocMustSucceed(prec->nelm, sizeof(double),
+                                         "throttle: aval");
+          prec->asnt = callocMustSucceed(prec->nelm, sizeof(double),
+                                         "throttle: asnt");
+        }
+
+      // WHSE reads the bin edges, which are the same for every record
+      prec->whse = waitBinEdges;
+
       return 0;
     }
 
@@ -159,6 +260,15 @@ static long init_record(void *precord,int pass)
   prpvt = prec->rpvt;
   prpvt->delay = prec->dly;
 
+  // start with a full bucket
+  if( prec->brst < 1.0)
+    prec->brst = 1.0;
+  prpvt->tokens = prec->brst;
+  prpvt->token_time = stdMonotonicSeconds();
+  prec->tokn = prpvt->tokens;
+
+  resetStatistics( prec);
+
   prpvt->limit_high = prec->drvlh;
   prpvt->limit_low = prec->drvll;
   if( prec->drvlh > prec->drvll)
@@ -199,6 +309,7 @@ static long init_record(void *precord,int pass)
         {
           *plinkValid = throttleOV_EXT_NC;
           *plinkStat = CA_LINK_NOT_OK;
+          addLinkCallback( prec, plink, i ? sinpMonitorCallback : NULL);
         }
       db_post_events(prec,plinkValid,DBE_VALUE|DBE_LOG);
     }
@@ -206,21 +317,39 @@ static long init_record(void *precord,int pass)
   callbackSetCallback(delayFuncCallback, &prpvt->delayFuncCb);
   callbackSetPriority(prec->prio, &prpvt->delayFuncCb);
   callbackSetUser(prec, &prpvt->delayFuncCb);
+  prpvt->use_wheel = throttleTimerEnabled();
+  if( prpvt->use_wheel)
+    throttleTimerInit(&prpvt->delayTimer, &prpvt->delayFuncCb);
+
+  callbackSetCallback(groupCallback, &prpvt->groupCb);
+  callbackSetPriority(prec->prio, &prpvt->groupCb);
+  callbackSetUser(prec, &prpvt->groupCb);
+  prpvt->group_turn = 0;
+  if( throttleGroupJoin(&prpvt->groupMember, prec->grp, &prpvt->groupCb) &&
+      (prec->grp[0] != '\0') )
+    errlogPrintf("%s: throttle group \"%s\" is not configured\n",
+                 prec->name, prec->grp);
   prpvt->delay_flag = 0;
   prpvt->wait_flag = 0;
+  prpvt->put_flag = 0;
+  prpvt->sent_flag = 0;
   prpvt->sync_flag = 0;
+  prpvt->sync_pending = 0;
+  prpvt->sync_value_wait = 0;
+
+  callbackSetCallback(syncCallback, &prpvt->syncCb);
+  callbackSetPriority(prec->prio, &prpvt->syncCb);
+  callbackSetUser(prec, &prpvt->syncCb);
+
+  callbackSetCallback(syncTimeoutCallback, &prpvt->syncTimeoutCb);
+  callbackSetPriority(prec->prio, &prpvt->syncTimeoutCb);
+  callbackSetUser(prec, &prpvt->syncTimeoutCb);
 
   callbackSetCallback(checkLinkCallback, &prpvt->checkLinkCb);
   callbackSetPriority(prec->prio, &prpvt->checkLinkCb);
   callbackSetUser(prec, &prpvt->checkLinkCb);
   prpvt->pending_checkLinkCB = 0;
-  
-  if((prpvt->outLinkStat == CA_LINK_NOT_OK) || 
-     (prpvt->sinpLinkStat == CA_LINK_NOT_OK) )
-    {
-      prpvt->pending_checkLinkCB = 1;
-      callbackRequestDelayed(&prpvt->checkLinkCb, 1.0);
-    }
+  // the connection callbacks will update the link status
 
   /* end link management */
 
@@ -238,8 +367,11 @@ static long process(throttleRecord *prec)
   prec->pact = TRUE;
   prec->udf = FALSE;
 
+  if( (prec->mode == throttleMODE_MONITOR) && readInput( prec) )
+    proc_flag = 0;
  
-  if( prpvt->limit_flag)
+  // the drive limits only apply to VAL
+  if( prpvt->limit_flag && (prec->nelm == 1) )
     {
       int new_st;
 
@@ -254,6 +386,8 @@ static long process(throttleRecord *prec)
             {
               prec->val = prec->oval;
               proc_flag = 0;
+              prec->nrej++;
+              db_post_events(prec,&prec->nrej,DBE_VALUE);
             }
           new_st = throttleDRVLS_LOW;
         }
@@ -268,6 +402,8 @@ static long process(throttleRecord *prec)
             {
               prec->val = prec->oval;
               proc_flag = 0;
+              prec->nrej++;
+              db_post_events(prec,&prec->nrej,DBE_VALUE);
             }
           new_st = throttleDRVLS_HIGH;
         }
@@ -284,25 +420,29 @@ static long process(throttleRecord *prec)
 
   if( proc_flag)
     {
-      prec->wait = TRUE;
-      db_post_events(prec,&prec->wait,DBE_VALUE);
-
-     /* if link is CA, check connection */
-      if (prpvt->outLinkStat != NOT_CA_LINK)
+      if( !prec->wait)
         {
-          checkLink(prec);
+          prec->wait = TRUE;
+          db_post_events(prec,&prec->wait,DBE_VALUE);
         }
+
       enterValue( prec);
     }
 
   monitor_mask = recGblResetAlarms(prec);
-  if(prec->oval != prec->val) 
+  // in monitor mode the value is posted when it is sent
+  if( (prec->oval != prec->val) && (prec->mode != throttleMODE_MONITOR) )
     {
       monitor_mask |= DBE_VALUE|DBE_LOG;
       prec->oval = prec->val;
     }
   if(monitor_mask)
     db_post_events(prec,&prec->val,monitor_mask);
+  if( (prec->nelm > 1) && (prec->mode != throttleMODE_MONITOR) )
+    {
+      db_post_events(prec,prec->aval,DBE_VALUE|DBE_LOG);
+      db_post_events(prec,&prec->nord,DBE_VALUE|DBE_LOG);
+    }
 
   /* process the forward scan link record */
   /* recGblFwdLink(prec); */
@@ -364,12 +504,12 @@ static long special(DBADDR *paddr, int after)
       else 
         {
           *plinkValid = throttleOV_EXT_NC;
-          if (!prpvt->pending_checkLinkCB) 
-            {
-              prpvt->pending_checkLinkCB = 1;
-              callbackRequestDelayed(&prpvt->checkLinkCb, 0.5);
-              prpvt->outLinkStat = CA_LINK_NOT_OK;
-            }
+          if( fieldIndex == throttleRecordOUT)
+            prpvt->outLinkStat = CA_LINK_NOT_OK;
+          else
+            prpvt->sinpLinkStat = CA_LINK_NOT_OK;
+          addLinkCallback( prec, plink, (fieldIndex == throttleRecordSINP) ?
+                           sinpMonitorCallback : NULL);
         }
       db_post_events(prec,plinkValid,DBE_VALUE|DBE_LOG);
 
@@ -378,16 +518,13 @@ static long special(DBADDR *paddr, int after)
       if( prec->sync == throttleSYNC_IDLE)
         break;
 
-      /* if some links are CA, check connections */
-      if( prec->siv == throttleOV_EXT_NC)
+      // done from a callback task, so the client writing SYNC isn't held
+      // up; SYNC stays at Process until it is done
+      if( !prpvt->sync_pending)
         {
-          checkLink(prec);
-          if( prec->siv == throttleOV_EXT)
-            valueSync(prec);
+          prpvt->sync_pending = 1;
+          callbackRequest(&prpvt->syncCb);
         }
-      else
-        valueSync(prec);
-      
       break;
     case(throttleRecordDLY):
       if( prec->dly < 0.0)
@@ -399,12 +536,29 @@ static long special(DBADDR *paddr, int after)
       else
         prpvt->delay = prec->dly;
       
-      if(prpvt->delay_flag == 1)
+      if( prec->mode == throttleMODE_TOKEN)
+        refillTokens( prec);
+      restartDelay( prec);
+      break;
+
+    case(throttleRecordMODE):
+    case(throttleRecordRATE):
+    case(throttleRecordBRST):
+      if( prec->brst < 1.0)
+        {
+          prec->brst = 1.0;
+          db_post_events(prec,&prec->brst,DBE_VALUE);
+        }
+      refillTokens( prec);
+      restartDelay( prec);
+      break;
+
+    case(throttleRecordCRST):
+      if( prec->crst)
         {
-          // in case the delay was set crazy big, 
-          // this kills it and restarts it with new value
-          callbackCancelDelayed(&prpvt->delayFuncCb);
-          callbackRequestDelayed(&prpvt->delayFuncCb, prpvt->delay);
+          resetStatistics( prec);
+          prec->crst = 0;
+          db_post_events(prec,&prec->crst,DBE_VALUE);
         }
       break;
 
@@ -448,6 +602,86 @@ static long special(DBADDR *paddr, int after)
 }
 
 
+static long cvt_dbaddr(DBADDR *paddr)
+{
+  throttleRecord *prec = (throttleRecord *)paddr->precord;
+
+  switch(dbGetFieldIndex(paddr))
+    {
+    case(throttleRecordAVAL):
+    case(throttleRecordASNT):
+      // the buffers may not be allocated yet, so get_array_info() sets
+      // pfield again
+      if( dbGetFieldIndex(paddr) == throttleRecordAVAL)
+        paddr->pfield = (prec->nelm > 1) ? (void *) prec->aval : &prec->val;
+      else
+        {
+          paddr->pfield = (prec->nelm > 1) ? (void *) prec->asnt : &prec->sent;
+          paddr->special = SPC_NOMOD;
+        }
+      paddr->no_elements = (prec->nelm > 1) ? prec->nelm : 1;
+      paddr->field_type = DBF_DOUBLE;
+      paddr->field_size = sizeof(double);
+      paddr->dbr_field_type = DBR_DOUBLE;
+      return 0;
+    case(throttleRecordWHST):
+      paddr->pfield = prec->whst;
+      paddr->no_elements = THROTTLE_NUM_WAIT_BINS;
+      paddr->field_type = DBF_ULONG;
+      paddr->field_size = sizeof(epicsUInt32);
+      paddr->dbr_field_type = DBR_ULONG;
+      break;
+    case(throttleRecordWHSE):
+      paddr->pfield = (void *) prec->whse;
+      paddr->no_elements = THROTTLE_NUM_WAIT_BINS - 1;
+      paddr->field_type = DBF_DOUBLE;
+      paddr->field_size = sizeof(double);
+      paddr->dbr_field_type = DBR_DOUBLE;
+      break;
+    default:
+      return S_db_badField;
+    }
+  // both are read only
+  paddr->special = SPC_NOMOD;
+
+  return 0;
+}
+
+static long get_array_info(DBADDR *paddr, long *no_elements, long *offset)
+{
+  throttleRecord *prec = (throttleRecord *)paddr->precord;
+
+  switch(dbGetFieldIndex(paddr))
+    {
+    case(throttleRecordAVAL):
+      // with NELM 1 AVAL is VAL
+      paddr->pfield = (prec->nelm > 1) ? (void *) prec->aval : &prec->val;
+      *no_elements = (prec->nelm > 1) ? prec->nord : 1;
+      break;
+    case(throttleRecordASNT):
+      paddr->pfield = (prec->nelm > 1) ? (void *) prec->asnt : &prec->sent;
+      *no_elements = (prec->nelm > 1) ? prec->sord : 1;
+      break;
+    default:
+      *no_elements = paddr->no_elements;
+      break;
+    }
+  *offset = 0;
+
+  return 0;
+}
+
+static long put_array_info(DBADDR *paddr, long nNew)
+{
+  throttleRecord *prec = (throttleRecord *)paddr->precord;
+
+  if( (dbGetFieldIndex(paddr) == throttleRecordAVAL) && (prec->nelm > 1) )
+    prec->nord = nNew;
+
+  return 0;
+}
+
+
 static long get_precision(dbAddr *paddr, long *precision)
 {
   throttleRecord *prec = (throttleRecord *)paddr->precord;
@@ -521,8 +755,17 @@ static void enterValue( throttleRecord *prec)
 
   //  printf("enterValue()\n");
 
+  // a value that hasn't been sent yet is replaced by this one
+  if( prpvt->wait_flag)
+    {
+      prec->ncoa++;
+      db_post_events(prec,&prec->ncoa,DBE_VALUE);
+    }
+  else
+    prpvt->wait_start = stdMonotonicSeconds();
+
   prpvt->wait_flag = 1; // trigger send
-  if( !prpvt->delay_flag)
+  if( !prpvt->delay_flag && !prpvt->put_flag)
     valuePut( prec);
   // else it will be set at next callback
 }
@@ -534,70 +777,206 @@ static void delayFuncCallback(CALLBACK *pcallback)
   //  printf("delayFuncCallback()\n");
 
   callbackGetUser(prec, pcallback);
+
+  dbScanLock((struct dbCommon *)prec);
   valuePut( prec);
+  dbScanUnlock((struct dbCommon *)prec);
 }
 
 static void valuePut( throttleRecord *prec)
 {
   rpvtStruct *prpvt = prec->rpvt;
-  unsigned short  monitor_mask;
 
   struct link *plink;
+  double *pbuf;
 
   long status;
 
   //  printf("valuePut(), wf%d, df%d\n", prpvt->wait_flag, prpvt->delay_flag);
 
+  if( prec->mode == throttleMODE_TOKEN)
+    {
+      refillTokens( prec);
+      // a value is sent for every whole token
+      if( prpvt->wait_flag && (prpvt->tokens < 1.0) )
+        {
+          prpvt->delay_flag = 1;
+          delayStart( prec, nextDelay( prec));
+          return;
+        }
+    }
+
+  if( prpvt->put_flag)
+    {
+      // the delay is over, but the value is sent when the put completes
+      prpvt->delay_flag = 0;
+      return;
+    }
+
+  // a grouped record may have to wait for its turn, sending its latest
+  // value then
+  if( prpvt->wait_flag && !prpvt->group_turn && 
+      !throttleGroupRequest(&prpvt->groupMember) )
+    {
+      prpvt->delay_flag = 0;
+      return;
+    }
+
   if( prpvt->wait_flag)
     {
       // needs to be before valueSync()
       prpvt->wait_flag = 0;
+      // the group turn, if this is one, is used
+      prpvt->group_turn = 0;
 
       /* Process output link. */
       plink = &(prec->out);
       if (plink->type != CONSTANT)
         {
-          prpvt->oval = prec->val;
-          
-          status = dbPutLink(plink, DBR_DOUBLE, &prpvt->oval, 1);
-          if( RTN_SUCCESS( status) )
+          prpvt->oval = rampValue( prec);
+          // when ramping, the rest of the way is sent after the next delay
+          if( prpvt->oval != prec->val)
+            prpvt->wait_flag = 1;
+          else
+            waitStatistics( prec);
+
+          if( prec->nelm > 1)
             {
-              prec->sts = throttleSTS_SUC;
-              prec->sent = prpvt->oval;
-              db_post_events(prec,&prec->sent,DBE_VALUE);
+              // AVAL can be written while the copy is being sent
+              memcpy( prec->asnt, prec->aval, prec->nord * sizeof(double));
+              prpvt->nsend = prec->nord;
+              pbuf = prec->asnt;
+            }
+          else
+            {
+              prpvt->nsend = 1;
+              pbuf = &prpvt->oval;
+            }
 
-              if(prpvt->sync_flag == 1)
-                valueSync(prec);
+          if( (prec->omod == throttleOMOD_CALLBACK) && 
+              (plink->type == CA_LINK) )
+            {
+              status = dbCaPutLinkCallback(plink, DBR_DOUBLE, pbuf,
+                                           prpvt->nsend, putCallback, prec);
+              if( RTN_SUCCESS( status) )
+                prpvt->put_flag = 1;
             }
           else
-            prec->sts = throttleSTS_ERR;
+            status = dbPutLink(plink, DBR_DOUBLE, pbuf, prpvt->nsend);
+        }
+      else
+        {
+          waitStatistics( prec);
+          if( prec->nelm > 1)
+            {
+              memcpy( prec->asnt, prec->aval, prec->nord * sizeof(double));
+              prpvt->nsend = prec->nord;
+            }
+          else
+            prpvt->oval = prec->val;
+          // in monitor mode, OUT is optional
+          status = (prec->mode == throttleMODE_MONITOR) ? 0 : -1;
+        }
+
+      // the delay starts when the value is sent
+      if( spendToken( prec))
+        prpvt->delay_flag = 0;
+      else
+        {
+          prpvt->delay_flag = 1;
+          delayStart( prec, nextDelay( prec));
+        }
+
+      if( !prpvt->put_flag)
+        valuePutDone( prec, status);
+    }
+  else
+    {
+      prpvt->delay_flag = 0;
+
+      monitor( prec);
+    }
+}
 
-          prec->wait = FALSE;
-          db_post_events(prec,&prec->wait,DBE_VALUE);
 
+/* Finish sending a value, once the output link has been written. */
+static void valuePutDone( throttleRecord *prec, long status)
+{
+  rpvtStruct *prpvt = prec->rpvt;
 
-          // NOW process forward link!
-          recGblFwdLink(prec);
+  if( (prec->out.type != CONSTANT) || (prec->mode == throttleMODE_MONITOR) )
+    {
+      if( RTN_SUCCESS( status) )
+        {
+          prec->sts = throttleSTS_SUC;
+          if( prec->nelm > 1)
+            {
+              prec->sord = prpvt->nsend;
+              db_post_events(prec,prec->asnt,DBE_VALUE|DBE_LOG);
+              db_post_events(prec,&prec->sord,DBE_VALUE|DBE_LOG);
+            }
+          else
+            {
+              prec->sent = prpvt->oval;
+              db_post_events(prec,&prec->sent,DBE_VALUE);
+              prpvt->sent_flag = 1;
+            }
+
+          if( prec->mode == throttleMODE_MONITOR)
+            {
+              // the rate limited value, with the time stamp of the input
+              prec->time = prpvt->inp_time;
+              if( prec->nelm > 1)
+                {
+                  db_post_events(prec,prec->aval,DBE_VALUE|DBE_LOG);
+                  db_post_events(prec,&prec->nord,DBE_VALUE|DBE_LOG);
+                }
+              else if( prec->oval != prpvt->oval)
+                {
+                  prec->oval = prpvt->oval;
+                  db_post_events(prec,&prec->val,DBE_VALUE|DBE_LOG);
+                }
+            }
+
+          prec->nsnt++;
+          db_post_events(prec,&prec->nsnt,DBE_VALUE);
+
+          if(prpvt->sync_flag == 1)
+            valueSync(prec);
         }
       else
-        {
-          prec->sts = throttleSTS_ERR;
+        prec->sts = throttleSTS_ERR;
 
+      // a newer value may have arrived while a put callback was outstanding
+      if( !prpvt->wait_flag)
+        {
           prec->wait = FALSE;
           db_post_events(prec,&prec->wait,DBE_VALUE);
         }
 
-      db_post_events(prec,&prec->sts,DBE_VALUE);
-
-      prpvt->delay_flag = 1;
-      callbackRequestDelayed(&prpvt->delayFuncCb, prpvt->delay);
+      // NOW process forward link!
+      recGblFwdLink(prec);
     }
   else
     {
-      prpvt->delay_flag = 0;
+      prec->sts = throttleSTS_ERR;
+
+      prec->wait = FALSE;
+      db_post_events(prec,&prec->wait,DBE_VALUE);
     }
 
-  recGblGetTimeStamp(prec);
+  db_post_events(prec,&prec->sts,DBE_VALUE);
+
+  monitor( prec);
+}
+
+
+static void monitor( throttleRecord *prec)
+{
+  unsigned short  monitor_mask;
+
+  if( prec->mode != throttleMODE_MONITOR)
+    recGblGetTimeStamp(prec);
   /* check for alarms */
   checkAlarms(prec);
 
@@ -613,6 +992,154 @@ static void valuePut( throttleRecord *prec)
 }
 
 
+/* Called from the dbCa task when a put callback on OUT completes.  dbCa
+   doesn't pass on the status of the put, so it counts as failed if the
+   link has disconnected or the target is in an INVALID alarm. */
+static void putCallback( void *userPvt)
+{
+  throttleRecord *prec = (throttleRecord *) userPvt;
+  rpvtStruct *prpvt = prec->rpvt;
+  epicsEnum16 stat, sevr;
+  long status = 0;
+
+  dbScanLock((struct dbCommon *)prec);
+
+  if( !dbCaIsLinkConnected(&prec->out) || 
+      dbCaGetAlarm(&prec->out, &stat, &sevr) || (sevr >= INVALID_ALARM) )
+    status = -1;
+
+  prpvt->put_flag = 0;
+  valuePutDone( prec, status);
+
+  // send anything that came in while waiting, if the delay is also over
+  if( !prpvt->delay_flag && prpvt->wait_flag)
+    valuePut( prec);
+
+  dbScanUnlock((struct dbCommon *)prec);
+}
+
+
+/* Called when the throttle group gives the record its turn to send. */
+static void groupCallback( CALLBACK *pcallback)
+{
+  struct throttleRecord *prec;
+  rpvtStruct *prpvt;
+
+  callbackGetUser(prec, pcallback);
+  prpvt = prec->rpvt;
+
+  dbScanLock((struct dbCommon *)prec);
+
+  // valuePut() clears group_turn if it sends a value; if it can't, the
+  // turn goes to the next member of the group
+  prpvt->group_turn = 1;
+  valuePut( prec);
+  throttleGroupTurnDone(&prpvt->groupMember, !prpvt->group_turn);
+  prpvt->group_turn = 0;
+
+  dbScanUnlock((struct dbCommon *)prec);
+}
+
+
+/* Carry out a SYNC request.  A CA SINP that hasn't delivered a value yet
+   is waited for, see sinpMonitorCallback(), for up to SYNC_TIMEOUT
+   seconds. */
+static void syncCallback( CALLBACK *pcallback)
+{
+  struct throttleRecord *prec;
+  rpvtStruct *prpvt;
+  struct link *plink;
+  unsigned long count;
+  double dummy;
+
+  callbackGetUser(prec, pcallback);
+  prpvt = prec->rpvt;
+  plink = &prec->sinp;
+
+  dbScanLock((struct dbCommon *)prec);
+
+  if( !prpvt->sync_pending)
+    {
+      dbScanUnlock((struct dbCommon *)prec);
+      return;
+    }
+
+  if( (plink->type == CA_LINK) && 
+      (!dbCaIsLinkConnected(plink) || dbCaGetUpdateCount(plink, &count) ||
+       (count == 0)) )
+    {
+      // this also makes sure the link is subscribed to the value
+      dbGetLink(plink, DBR_DOUBLE, &dummy, NULL, NULL);
+      if( !prpvt->sync_value_wait)
+        {
+          prpvt->sync_value_wait = 1;
+          callbackRequestDelayed(&prpvt->syncTimeoutCb, SYNC_TIMEOUT);
+        }
+    }
+  else
+    {
+      if( prpvt->sync_value_wait)
+        {
+          prpvt->sync_value_wait = 0;
+          callbackCancelDelayed(&prpvt->syncTimeoutCb);
+        }
+      prpvt->sync_pending = 0;
+      valueSync(prec);
+    }
+
+  dbScanUnlock((struct dbCommon *)prec);
+}
+
+
+/* The CA SINP didn't deliver a value in time for a SYNC. */
+static void syncTimeoutCallback( CALLBACK *pcallback)
+{
+  struct throttleRecord *prec;
+  rpvtStruct *prpvt;
+
+  callbackGetUser(prec, pcallback);
+  prpvt = prec->rpvt;
+
+  dbScanLock((struct dbCommon *)prec);
+  if( prpvt->sync_pending && prpvt->sync_value_wait)
+    syncFail( prec);
+  dbScanUnlock((struct dbCommon *)prec);
+}
+
+
+/* Give up on a SYNC, leaving VAL alone. */
+static void syncFail( throttleRecord *prec)
+{
+  rpvtStruct *prpvt = prec->rpvt;
+
+  prpvt->sync_pending = 0;
+  prpvt->sync_value_wait = 0;
+
+  prec->sts = throttleSTS_ERR;
+  db_post_events(prec,&prec->sts,DBE_VALUE);
+
+  prec->sync = throttleSYNC_IDLE;
+  db_post_events(prec,&prec->sync,DBE_VALUE);
+}
+
+
+/* Called from the dbCa task when a value arrives on a CA SINP.  The SYNC
+   waiting for it is finished by syncCallback(). */
+static void sinpMonitorCallback( void *userPvt)
+{
+  throttleRecord *prec = (throttleRecord *) userPvt;
+  rpvtStruct *prpvt = prec->rpvt;
+
+  if( !interruptAccept)
+    return;
+
+  dbScanLock((struct dbCommon *)prec);
+  if( prpvt->sync_value_wait)
+    callbackRequest(&prpvt->syncCb);
+  dbScanUnlock((struct dbCommon *)prec);
+}
+
+
 static void valueSync( throttleRecord *prec)
 {
   rpvtStruct *prpvt = prec->rpvt;
@@ -684,15 +1211,13 @@ static void checkLink(struct throttleRecord *prec)
 {
   struct rpvtStruct   *prpvt = (struct rpvtStruct *)prec->rpvt;
   int stat;
-  int caLink   = 0;
-  int caLinkNc = 0;
+  int caLink;
+  int caLinkNc;
 
   struct link *plink;
   unsigned short *plinkValid;
   short      *plinkStat;
 
-  int sched_flag = 0;
-
   int i;
 
   for( i = 0; i < 2; i++)
@@ -710,6 +1235,8 @@ static void checkLink(struct throttleRecord *prec)
           plinkStat = &prpvt->sinpLinkStat;
         }
 
+      caLink = 0;
+      caLinkNc = 0;
       if (plink->type == CA_LINK) 
         {
           caLink = 1;
@@ -731,23 +1258,292 @@ static void checkLink(struct throttleRecord *prec)
             } 
         }
       
+      // a SYNC waiting for a value from SINP won't get one now
+      if( i && caLinkNc && prpvt->sync_value_wait)
+        {
+          callbackCancelDelayed(&prpvt->syncTimeoutCb);
+          syncFail( prec);
+        }
+
       if (caLinkNc)
         *plinkStat = CA_LINK_NOT_OK;
       else if (caLink)
         *plinkStat = CA_LINK_OK;
       else
         *plinkStat = NOT_CA_LINK;
-
-      if( caLinkNc)
-        sched_flag = 1;
     }
+}
+
 
+/* Called from the dbCa task when the OUT or SINP channel connects or
+   disconnects.  The link status is updated from a callback task, so that
+   the dbCa task isn't held up by the record. */
+static void linkConnectCallback( void *userPvt)
+{
+  throttleRecord *prec = (throttleRecord *) userPvt;
+  rpvtStruct *prpvt = prec->rpvt;
 
-  if(!prpvt->pending_checkLinkCB && sched_flag) 
+  // the record can't be locked until iocInit is done, see
+  // checkLinkCallback()
+  if( interruptAccept)
+    dbScanLock((struct dbCommon *)prec);
+
+  if( !prpvt->pending_checkLinkCB)
     {
-      /* Schedule another CALLBACK */
       prpvt->pending_checkLinkCB = 1;
-      callbackRequestDelayed(&prpvt->checkLinkCb, 0.5);
+      callbackRequest(&prpvt->checkLinkCb);
     }
+
+  if( interruptAccept)
+    dbScanUnlock((struct dbCommon *)prec);
+}
+
+
+/* Replace the channel of a CA link with one that reports its connection
+   state changes, and optionally its value changes. */
+static void addLinkCallback( throttleRecord *prec, struct link *plink,
+                             dbCaCallback monitor)
+{
+  short pvlMask;
+
+  if (plink->type != CA_LINK) 
+    return;
+
+  // dbCaRemoveLink() clears the link options (CA, CP, MS, ...)
+  pvlMask = plink->value.pv_link.pvlMask;
+#if LT_EPICSBASE(3,16,0,1)
+  dbCaRemoveLink(plink);
+#else
+  dbCaRemoveLink(NULL, plink);
+#endif
+  plink->value.pv_link.pvlMask = pvlMask;
+  dbCaAddLinkCallback(plink, linkConnectCallback, monitor, prec);
 }
 
+
+
+/* Tokens earned per second.  Without a sustained rate, a token is earned
+   every DLY seconds, and with neither the bucket is always full. */
+static double tokenRate( throttleRecord *prec)
+{
+  rpvtStruct *prpvt = prec->rpvt;
+
+  if( prec->rate > 0.0)
+    return prec->rate;
+  if( prpvt->delay > 0.0)
+    return 1.0 / prpvt->delay;
+  return 0.0;
+}
+
+
+/* Add the credit earned since the last update, up to BRST tokens.  As with
+   spendToken(), the record must be locked: the bucket is shared by puts to
+   VAL and the callbacks that send values. */
+static void refillTokens( throttleRecord *prec)
+{
+  rpvtStruct *prpvt = prec->rpvt;
+  double now;
+  double rate;
+
+  now = stdMonotonicSeconds();
+  rate = tokenRate( prec);
+  if( rate > 0.0)
+    prpvt->tokens += (now - prpvt->token_time) * rate;
+  else
+    prpvt->tokens = prec->brst;
+  if( prpvt->tokens > prec->brst)
+    prpvt->tokens = prec->brst;
+  prpvt->token_time = now;
+
+  if( prec->tokn != prpvt->tokens)
+    {
+      prec->tokn = prpvt->tokens;
+      db_post_events(prec,&prec->tokn,DBE_VALUE);
+    }
+}
+
+
+/* How long until the delay callback should next try to send a value. */
+static double nextDelay( throttleRecord *prec)
+{
+  rpvtStruct *prpvt = prec->rpvt;
+  double rate;
+
+  if( prec->mode != throttleMODE_TOKEN)
+    return prpvt->delay;
+
+  rate = tokenRate( prec);
+  if( (prpvt->tokens >= 1.0) || (rate <= 0.0) )
+    return 0.0;
+  return (1.0 - prpvt->tokens) / rate;
+}
+
+
+/* In token bucket mode, spend a token on the value that was just sent.
+   Returns 1 if the next value can be sent without waiting. */
+static int spendToken( throttleRecord *prec)
+{
+  rpvtStruct *prpvt = prec->rpvt;
+
+  if( prec->mode != throttleMODE_TOKEN)
+    return 0;
+
+  prpvt->tokens -= 1.0;
+  if( prpvt->tokens < 0.0)
+    prpvt->tokens = 0.0;
+  prec->tokn = prpvt->tokens;
+  db_post_events(prec,&prec->tokn,DBE_VALUE);
+
+  return (prpvt->tokens >= 1.0);
+}
+
+
+/* Restart a pending delay callback, after the delay or rate changed. */
+static void restartDelay( throttleRecord *prec)
+{
+  rpvtStruct *prpvt = prec->rpvt;
+
+  if(prpvt->delay_flag == 1)
+    {
+      // in case the delay was set crazy big, 
+      // this kills it and restarts it with new value
+      delayCancel( prec);
+      delayStart( prec, nextDelay( prec));
+    }
+}
+
+
+
+static void delayStart( throttleRecord *prec, double delay)
+{
+  rpvtStruct *prpvt = prec->rpvt;
+
+  if( prpvt->use_wheel)
+    throttleTimerStart(&prpvt->delayTimer, delay);
+  else
+    callbackRequestDelayed(&prpvt->delayFuncCb, delay);
+}
+
+
+static void delayCancel( throttleRecord *prec)
+{
+  rpvtStruct *prpvt = prec->rpvt;
+
+  if( prpvt->use_wheel)
+    throttleTimerCancel(&prpvt->delayTimer);
+  else
+    callbackCancelDelayed(&prpvt->delayFuncCb);
+}
+
+
+
+/* The value to send next.  In ramp mode this is at most STEP away from the
+   last value sent; the first value after iocInit is sent as is, as there
+   is nothing to ramp from. */
+static double rampValue( throttleRecord *prec)
+{
+  rpvtStruct *prpvt = prec->rpvt;
+  double step;
+
+  if( (prec->mode != throttleMODE_RAMP) || !prpvt->sent_flag || 
+      (prec->step <= 0.0) )
+    return prec->val;
+
+  step = prec->val - prec->sent;
+  if( step > prec->step)
+    return prec->sent + prec->step;
+  if( step < -prec->step)
+    return prec->sent - prec->step;
+  return prec->val;
+}
+
+
+/* In monitor mode, read the latest value and time stamp from INP.  Returns
+   non-zero if there is no value to throttle. */
+static int readInput( throttleRecord *prec)
+{
+  rpvtStruct *prpvt = prec->rpvt;
+  long nRequest = prec->nelm;
+  long status;
+
+  if( prec->inp.type == CONSTANT)
+    {
+      // VAL is written directly
+      recGblGetTimeStamp(prec);
+      prpvt->inp_time = prec->time;
+      return 0;
+    }
+
+  if( prec->nelm > 1)
+    {
+      status = dbGetLink(&prec->inp, DBR_DOUBLE, prec->aval, NULL, &nRequest);
+      if( RTN_SUCCESS( status) )
+        prec->nord = nRequest;
+    }
+  else
+    status = dbGetLink(&prec->inp, DBR_DOUBLE, &prec->val, NULL, NULL);
+
+  if( !RTN_SUCCESS( status) )
+    {
+      recGblSetSevr(prec, LINK_ALARM, INVALID_ALARM);
+      return 1;
+    }
+
+  if( dbGetTimeStamp(&prec->inp, &prpvt->inp_time))
+    epicsTimeGetCurrent(&prpvt->inp_time);
+  prec->time = prpvt->inp_time;
+
+  return 0;
+}
+
+/* Add the wait of the value being sent to the statistics. */
+static void waitStatistics( throttleRecord *prec)
+{
+  rpvtStruct *prpvt = prec->rpvt;
+  double wait;
+  int i;
+
+  wait = stdMonotonicSeconds() - prpvt->wait_start;
+  if( wait < 0.0)
+    wait = 0.0;
+
+  for( i = 0; i < THROTTLE_NUM_WAIT_BINS - 1; i++)
+    if( wait <= waitBinEdges[i])
+      break;
+  prec->whst[i]++;
+  db_post_events(prec,prec->whst,DBE_VALUE);
+
+  prpvt->wait_sum += wait;
+  prpvt->wait_n++;
+  prec->wavg = prpvt->wait_sum / prpvt->wait_n;
+  db_post_events(prec,&prec->wavg,DBE_VALUE);
+  if( wait > prec->wmax)
+    {
+      prec->wmax = wait;
+      db_post_events(prec,&prec->wmax,DBE_VALUE);
+    }
+}
+
+
+static void resetStatistics( throttleRecord *prec)
+{
+  rpvtStruct *prpvt = prec->rpvt;
+  int i;
+
+  prec->ncoa = 0;
+  prec->nsnt = 0;
+  prec->nrej = 0;
+  prec->wavg = 0.0;
+  prec->wmax = 0.0;
+  for( i = 0; i < THROTTLE_NUM_WAIT_BINS; i++)
+    prec->whst[i] = 0;
+  prpvt->wait_sum = 0.0;
+  prpvt->wait_n = 0;
+
+  db_post_events(prec,&prec->ncoa,DBE_VALUE);
+  db_post_events(prec,&prec->nsnt,DBE_VALUE);
+  db_post_events(prec,&prec->nrej,DBE_VALUE);
+  db_post_events(prec,&prec->wavg,DBE_VALUE);
+  db_post_events(prec,&prec->wmax,DBE_VALUE);
+  db_post_events(prec,prec->whst,DBE_VALUE);
+}
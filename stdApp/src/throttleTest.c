@@ -0,0 +1,142 @@
+/* throttleTest.c */
+
+/***************************************************
+
+throttleTest.c -
+Tests of the throttle record in a test IOC
+
+Several threads write VAL as fast as they can while the delay callback is
+sending values, in token bucket mode.  Every value written must either be
+sent or replaced by a later one, the rate must not be exceeded, and the
+last value written must be the one sent in the end.
+
+Modification Log:
+----------------
+10/19/2026 AG   First version.
+
+*****************************************************/
+
+#include <math.h>
+
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsTime.h>
+#include <errlog.h>
+#include <dbAccess.h>
+#include <dbUnitTest.h>
+#include <testMain.h>
+
+#define NUM_WRITERS 2
+#define NUM_WRITES 20000
+#define RATE 200.0
+#define BURST 5.0
+
+void throttleTest_registerRecordDeviceDriver(struct dbBase *);
+
+typedef struct
+{
+  int id;
+  epicsEventId done;
+} writerStruct;
+
+static void writer( void *arg)
+{
+  writerStruct *pwriter = (writerStruct *) arg;
+  DBADDR addr;
+  double value;
+  int i;
+
+  if( dbNameToAddr( "throttle.VAL", &addr))
+    testAbort("no throttle.VAL");
+
+  for( i = 0; i < NUM_WRITES; i++)
+    {
+      value = pwriter->id * NUM_WRITES + i;
+      dbPutField(&addr, DBR_DOUBLE, &value, 1);
+      // let the delay callback in now and then
+      if( !(i % 1000))
+        epicsThreadSleep(0.001);
+    }
+
+  epicsEventSignal(pwriter->done);
+}
+
+static epicsUInt32 getULong( const char *pv)
+{
+  DBADDR addr;
+  epicsUInt32 value = 0;
+
+  if( dbNameToAddr( pv, &addr) || 
+      dbGetField(&addr, DBR_ULONG, &value, NULL, NULL, NULL) )
+    testAbort("can't read %s", pv);
+  return value;
+}
+
+static void testHammer(void)
+{
+  writerStruct writers[NUM_WRITERS];
+  epicsTimeStamp start, end;
+  epicsUInt32 nsnt, ncoa, nrej;
+  double elapsed;
+  int i;
+
+  testDiag("%d threads writing VAL %d times each", NUM_WRITERS, NUM_WRITES);
+
+  epicsTimeGetCurrent(&start);
+  for( i = 0; i < NUM_WRITERS; i++)
+    {
+      writers[i].id = i;
+      writers[i].done = epicsEventMustCreate(epicsEventEmpty);
+      epicsThreadMustCreate("throttleWriter", epicsThreadPriorityMedium,
+                            epicsThreadGetStackSize(epicsThreadStackSmall),
+                            writer, &writers[i]);
+    }
+  for( i = 0; i < NUM_WRITERS; i++)
+    {
+      epicsEventMustWait(writers[i].done);
+      epicsEventDestroy(writers[i].done);
+    }
+
+  // a value nobody else wrote, which must be sent last
+  testdbPutFieldOk("throttle.VAL", DBR_DOUBLE, -1.0);
+  epicsTimeGetCurrent(&end);
+  elapsed = epicsTimeDiffInSeconds(&end, &start);
+
+  // long enough for the last token to be earned
+  epicsThreadSleep(10.0 / RATE + 0.5);
+
+  nsnt = getULong("throttle.NSNT");
+  ncoa = getULong("throttle.NCOA");
+  nrej = getULong("throttle.NREJ");
+  testDiag("sent %u, coalesced %u in %.3f s", nsnt, ncoa, elapsed);
+
+  testOk(nrej == 0, "no values rejected, NREJ=%u", nrej);
+  testOk(nsnt + ncoa == NUM_WRITERS * NUM_WRITES + 1,
+         "every value sent or replaced, NSNT+NCOA=%u", nsnt + ncoa);
+  testOk(nsnt <= BURST + RATE * (elapsed + 10.0 / RATE + 0.5) + 1,
+         "rate not exceeded, NSNT=%u", nsnt);
+  testdbGetFieldEqual("throttle.WAIT", DBR_LONG, 0);
+  testdbGetFieldEqual("throttle.SENT", DBR_DOUBLE, -1.0);
+  testdbGetFieldEqual("target.VAL", DBR_DOUBLE, -1.0);
+}
+
+MAIN(throttleTest)
+{
+  testPlan(7);
+
+  testdbPrepare();
+  testdbReadDatabase("throttleTest.dbd", NULL, NULL);
+  throttleTest_registerRecordDeviceDriver(pdbbase);
+  testdbReadDatabase("throttleTest.db", NULL, NULL);
+
+  eltc(0);
+  testIocInitOk();
+  eltc(1);
+
+  testHammer();
+
+  testIocShutdownOk();
+  testdbCleanup();
+
+  return testDone();
+}
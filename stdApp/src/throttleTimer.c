@@ -0,0 +1,314 @@
+/* throttleTimer.c */
+
+/***************************************************
+
+throttleTimer.c -
+Optional timer wheel shared by all throttle records
+
+With thousands of throttle records, each arming and re-arming its own
+delay on the EPICS timer queue, the queue is constantly churned.  The
+wheel hashes each timer into one of a fixed number of slots by its
+expiry tick, so starting and canceling a timer is a list insert or
+delete, and one thread wakes up once per tick to expire the timers in
+the current slot.
+
+iocsh commands:
+  throttleTimerConfig(tick, slots)  enable the wheel, before iocInit
+  throttleTimerReport(level)        show the timer load and lateness
+
+Modification Log:
+----------------
+10/19/2026 AG   First version.
+
+*****************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <epicsThread.h>
+#include <epicsMutex.h>
+#include <epicsTime.h>
+#include <cantProceed.h>
+#include <iocsh.h>
+#include <epicsExport.h>
+
+#include "throttleTimer.h"
+
+
+#include "stdCompat.h"
+
+
+typedef struct wheelStruct
+{
+  double tick;        /* seconds per slot */
+  int nslots;
+  ELLLIST *slots;
+  double last_tick;   /* last tick that was serviced */
+
+  epicsMutexId lock;
+  epicsThreadId thread;
+
+  /* statistics, for throttleTimerReport */
+  long armed;
+  long armed_max;
+  unsigned long started;
+  unsigned long canceled;
+  unsigned long expired;
+  unsigned long ticks;
+  unsigned long late_ticks;   /* wake ups that serviced more than one tick */
+  long expired_max;           /* most expired in one wake up */
+  double late_sum;
+  double late_max;
+} wheelStruct;
+
+static wheelStruct *pwheel = NULL;
+
+
+
+static void wheelRemove( throttleTimer *ptimer)
+{
+  ellDelete(&pwheel->slots[ptimer->slot], &ptimer->node);
+  ptimer->slot = -1;
+  pwheel->armed--;
+}
+
+
+static void wheelThread( void *arg)
+{
+  double now;
+  double this_tick;
+  double k;
+  long nexpired;
+  int n;
+
+  throttleTimer *ptimer;
+  throttleTimer *pnext;
+  ELLLIST *plist;
+
+  while(1)
+    {
+      epicsThreadSleep( pwheel->tick);
+
+      now = stdMonotonicSeconds();
+      this_tick = floor( now / pwheel->tick);
+
+      epicsMutexMustLock(pwheel->lock);
+
+      // catch up on the ticks missed, visiting each slot at most once
+      n = 0;
+      nexpired = 0;
+      for( k = pwheel->last_tick + 1; (k <= this_tick) && (n < pwheel->nslots);
+           k++, n++)
+        {
+          plist = &pwheel->slots[(int) fmod( k, pwheel->nslots)];
+          for( ptimer = (throttleTimer *) ellFirst(plist); ptimer != NULL;
+               ptimer = pnext)
+            {
+              pnext = (throttleTimer *) ellNext(&ptimer->node);
+
+              // timers further out than one turn of the wheel stay
+              if( ptimer->due > now)
+                continue;
+
+              wheelRemove( ptimer);
+              pwheel->expired++;
+              nexpired++;
+              pwheel->late_sum += now - ptimer->due;
+              if( now - ptimer->due > pwheel->late_max)
+                pwheel->late_max = now - ptimer->due;
+
+              callbackRequest( ptimer->pcallback);
+            }
+        }
+      if( this_tick - pwheel->last_tick > 1)
+        pwheel->late_ticks++;
+      if( this_tick > pwheel->last_tick)
+        pwheel->last_tick = this_tick;
+      pwheel->ticks++;
+      if( nexpired > pwheel->expired_max)
+        pwheel->expired_max = nexpired;
+
+      epicsMutexUnlock(pwheel->lock);
+    }
+}
+
+
+int throttleTimerEnabled(void)
+{
+  return (pwheel != NULL);
+}
+
+
+void throttleTimerInit( throttleTimer *ptimer, CALLBACK *pcallback)
+{
+  ptimer->pcallback = pcallback;
+  ptimer->due = 0.0;
+  ptimer->slot = -1;
+
+  // the thread starts with the first record that uses the wheel
+  if( (pwheel != NULL) && (pwheel->thread == NULL) )
+    {
+      pwheel->last_tick = floor( stdMonotonicSeconds() / pwheel->tick);
+      pwheel->thread =
+        epicsThreadMustCreate("throttleTimer", epicsThreadPriorityHigh,
+                            epicsThreadGetStackSize(epicsThreadStackSmall),
+                            wheelThread, NULL);
+    }
+}
+
+
+void throttleTimerStart( throttleTimer *ptimer, double delay)
+{
+  double due_tick;
+
+  if( delay <= 0.0)
+    {
+      throttleTimerCancel( ptimer);
+      callbackRequest( ptimer->pcallback);
+      return;
+    }
+
+  epicsMutexMustLock(pwheel->lock);
+
+  if( ptimer->slot >= 0)
+    wheelRemove( ptimer);
+  else
+    pwheel->started++;
+
+  ptimer->due = stdMonotonicSeconds() + delay;
+  // the first tick at or after the due time, but never one already serviced
+  due_tick = ceil( ptimer->due / pwheel->tick);
+  if( due_tick <= pwheel->last_tick)
+    due_tick = pwheel->last_tick + 1;
+  ptimer->slot = (int) fmod( due_tick, pwheel->nslots);
+  ellAdd(&pwheel->slots[ptimer->slot], &ptimer->node);
+
+  pwheel->armed++;
+  if( pwheel->armed > pwheel->armed_max)
+    pwheel->armed_max = pwheel->armed;
+
+  epicsMutexUnlock(pwheel->lock);
+}
+
+
+void throttleTimerCancel( throttleTimer *ptimer)
+{
+  epicsMutexMustLock(pwheel->lock);
+
+  if( ptimer->slot >= 0)
+    {
+      wheelRemove( ptimer);
+      pwheel->canceled++;
+    }
+
+  epicsMutexUnlock(pwheel->lock);
+}
+
+
+static void throttleTimerConfig( double tick, int nslots)
+{
+  int i;
+
+  if( pwheel != NULL)
+    {
+      printf("throttleTimerConfig: the timer wheel is already configured\n");
+      return;
+    }
+  if( tick <= 0.0)
+    {
+      printf("throttleTimerConfig: tick must be positive\n");
+      return;
+    }
+  if( nslots < 1)
+    nslots = 512;
+
+  pwheel = callocMustSucceed(1, sizeof(wheelStruct), "throttleTimerConfig");
+  pwheel->slots = callocMustSucceed(nslots, sizeof(ELLLIST),
+                                    "throttleTimerConfig");
+  for( i = 0; i < nslots; i++)
+    ellInit(&pwheel->slots[i]);
+  pwheel->tick = tick;
+  pwheel->nslots = nslots;
+  pwheel->lock = epicsMutexMustCreate();
+}
+
+
+static void throttleTimerReport( int level)
+{
+  int i;
+  int used = 0;
+  int longest = 0;
+
+  if( pwheel == NULL)
+    {
+      printf("throttleTimerReport: the timer wheel is not in use, "
+             "throttle records use the EPICS timer queue\n");
+      return;
+    }
+
+  epicsMutexMustLock(pwheel->lock);
+
+  printf("throttle timer wheel: %d slots of %g seconds\n", pwheel->nslots,
+         pwheel->tick);
+  printf("  armed %ld (max %ld), started %lu, canceled %lu, expired %lu\n",
+         pwheel->armed, pwheel->armed_max, pwheel->started, pwheel->canceled,
+         pwheel->expired);
+  printf("  ticks %lu, late wake ups %lu, max expired per tick %ld\n",
+         pwheel->ticks, pwheel->late_ticks, pwheel->expired_max);
+  printf("  lateness: mean %g, max %g seconds\n",
+         pwheel->expired ? pwheel->late_sum / pwheel->expired : 0.0,
+         pwheel->late_max);
+
+  if( level > 0)
+    {
+      for( i = 0; i < pwheel->nslots; i++)
+        {
+          if( ellCount(&pwheel->slots[i]) > 0)
+            used++;
+          if( ellCount(&pwheel->slots[i]) > longest)
+            longest = ellCount(&pwheel->slots[i]);
+        }
+      printf("  slots in use %d, longest slot %d\n", used, longest);
+    }
+
+  if( level > 1)
+    {
+      // start a new measurement
+      pwheel->armed_max = pwheel->armed;
+      pwheel->started = pwheel->canceled = pwheel->expired = 0;
+      pwheel->ticks = pwheel->late_ticks = 0;
+      pwheel->expired_max = 0;
+      pwheel->late_sum = pwheel->late_max = 0.0;
+      printf("  statistics reset\n");
+    }
+
+  epicsMutexUnlock(pwheel->lock);
+}
+
+
+static const iocshArg configArg0 = { "tick", iocshArgDouble };
+static const iocshArg configArg1 = { "slots", iocshArgInt };
+static const iocshArg * const configArgs[2] = { &configArg0, &configArg1 };
+static const iocshFuncDef configFuncDef = { "throttleTimerConfig", 2,
+                                            configArgs };
+static void configCallFunc( const iocshArgBuf *args)
+{
+  throttleTimerConfig( args[0].dval, args[1].ival);
+}
+
+static const iocshArg reportArg0 = { "level", iocshArgInt };
+static const iocshArg * const reportArgs[1] = { &reportArg0 };
+static const iocshFuncDef reportFuncDef = { "throttleTimerReport", 1,
+                                            reportArgs };
+static void reportCallFunc( const iocshArgBuf *args)
+{
+  throttleTimerReport( args[0].ival);
+}
+
+static void throttleTimerRegister(void)
+{
+  iocshRegister(&configFuncDef, configCallFunc);
+  iocshRegister(&reportFuncDef, reportCallFunc);
+}
+epicsExportRegistrar(throttleTimerRegister);
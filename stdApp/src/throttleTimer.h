@@ -0,0 +1,56 @@
+/* throttleTimer.h */
+
+/***************************************************
+
+throttleTimer.h -
+Optional timer wheel shared by all throttle records
+
+Instead of each record putting its delay on the EPICS timer queue, the
+records can share one hashed timer wheel, serviced by a single thread with
+a coarse tick.  When a timer expires, the record's CALLBACK is queued with
+callbackRequest(), so the record's work is still done by the callback
+tasks.  The wheel is enabled with the throttleTimerConfig iocsh command
+before iocInit.
+
+Modification Log:
+----------------
+10/19/2026 AG   First version.
+
+*****************************************************/
+
+#ifndef INC_throttleTimer_H
+#define INC_throttleTimer_H
+
+#include <ellLib.h>
+#include <callback.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct throttleTimer
+{
+  ELLNODE node;         /* entry in a wheel slot */
+  CALLBACK *pcallback;  /* requested when the timer expires */
+  double due;           /* monotonic time of expiry */
+  int slot;             /* wheel slot, -1 when not armed */
+} throttleTimer;
+
+/* Returns 1 if throttleTimerConfig has enabled the wheel */
+int throttleTimerEnabled(void);
+
+void throttleTimerInit( throttleTimer *ptimer, CALLBACK *pcallback);
+
+/* Request the callback after delay seconds, rounded up to a whole tick.
+   A timer that is already armed is restarted. */
+void throttleTimerStart( throttleTimer *ptimer, double delay);
+
+/* Disarm the timer.  A callback that has already been requested will
+   still run, as with callbackCancelDelayed(). */
+void throttleTimerCancel( throttleTimer *ptimer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_throttleTimer_H */